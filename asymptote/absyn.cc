@@ -7,9 +7,24 @@
 
 #include "absyn.h"
 #include "coenv.h"
+#include "heap.h"
 
 namespace absyntax {
 
+namespace {
+mem::arena nodes;
+}
+
+void *absyn::operator new(size_t size)
+{
+  return nodes.allocate(size);
+}
+
+void releaseNodes()
+{
+  nodes.release();
+}
+
 void absyn::markPos(trans::coenv& e)
 {
   e.c.markPos(getPos());
@@ -37,11 +37,21 @@ public:
   }
 
   virtual void prettyprint(ostream &out, Int indent) = 0;
+
+  // Syntax trees are allocated from an arena, with the nodes of each file
+  // in blocks of their own; see releaseNodes.
+  static void *operator new(size_t size);
+  static void operator delete(void *) {}
 private:  // Non-copyable
   void operator=(const absyn&);
   absyn(const absyn&);
 };
 
+// Ends the blocks of the arena used for the nodes allocated so far.  Called
+// when a file has been parsed: the tree of a module is not needed once it is
+// translated, and the collector can then reclaim its blocks as a whole.
+void releaseNodes();
+
 void prettyindent(ostream &out, Int indent);
 void prettyname(ostream &out, string name, Int indent);
 
@@ -46,7 +46,7 @@ void bltinAccess::encode(action act, position pos, coder &e)
       bltinError(pos);
       break;
     case CALL:
-      e.encode(inst::builtin, f);
+      e.encodeBuiltin(f);
       break;
   }
 }
@@ -118,12 +118,16 @@ void localAccess::encode(action act, position pos, coder &e)
   // Get the active frame of the virtual machine.
   frame *active = e.getFrame();
   if (level == active) {
-    e.encode(act == WRITE ? inst::varsave : inst::varpush,
-             offset);
+    if (level->escaped(offset))
+      e.encode(act == WRITE ? inst::closuresave : inst::closurepush,
+               level->closureIndex(offset));
+    else
+      level->use(offset, e.encode(act == WRITE ? inst::varsave : inst::varpush,
+                                  offset));
   }
   else if (e.encode(level)) {
       e.encode(act == WRITE ? inst::fieldsave : inst::fieldpush,
-               offset);
+               level->closureIndex(offset));
   }
   else {
     frameError(pos);
@@ -137,7 +141,7 @@ void localAccess::encode(action act, position pos, coder &e, frame *top)
 {
   if (e.encode(level,top)) {
     e.encode(act == WRITE ? inst::fieldsave : inst::fieldpush,
-             offset);
+             level->closureIndex(offset));
     if (act == CALL)
       e.encode(inst::popcall);
   }
@@ -72,6 +72,9 @@ public:
   bltinAccess(vm::bltin f)
     : f(f) {}
 
+  vm::bltin getFunction()
+  { return f; }
+
   void encode(action act, position pos, coder &e);
   void encode(action act, position pos, coder &e, frame *);
 };
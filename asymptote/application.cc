@@ -38,9 +38,11 @@ score castScore(env &e, formal& target, formal& source) {
 }
 
 
-void restArg::transMaker(coenv &e, Int size, bool rest) {
+void restArg::transMaker(coenv &e, Int size, bool rest,
+                         types::ty *celltype) {
   // Push the number of cells and call the array maker.
   e.c.encode(inst::intpush, size);
+  e.c.encode(inst::constpush, (item)(celltype && pointerFree(celltype)));
   e.c.encode(inst::builtin, rest ? run::newAppendedArray :
              run::newInitializedArray);
 }
@@ -54,7 +56,7 @@ void restArg::trans(coenv &e, temp_vector &temps)
   if (rest)
     rest->trans(e, temps);
   
-  transMaker(e, (Int)inits.size(), (bool)rest);
+  transMaker(e, (Int)inits.size(), (bool)rest, celltype);
 }
 
 class maximizer {
@@ -128,15 +130,16 @@ ty *restCellType(signature *sig) {
 
 void application::initRest() {
   formal& f=sig->getRest();
+  ty *ct = 0;
   if (f.t) {
-    ty *ct = restCellType(sig);
+    ct = restCellType(sig);
     if (!ct)
       vm::error("formal rest argument must be an array");
 
     rf=formal(ct, symbol::nullsym, false, f.Explicit);
   }
   if (f.t || sig->isOpen) {
-    rest=new restArg();
+    rest=new restArg(ct);
   }
 }
 
@@ -439,7 +442,7 @@ bool exactlyMatchable(signature *target, signature *source)
 // here, we need not attempt to match others with the slower, more general
 // techniques.
 app_list exactMultimatch(env &e,
-                         types::overloaded *o,
+                         ty_vector &candidates,
                          types::signature *source,
                          arglist &al)
 {
@@ -451,7 +454,7 @@ app_list exactMultimatch(env &e,
   if (namedFormals(source))
     return l; /* empty */
 
-  for (ty_vector::iterator t=o->sub.begin(); t!=o->sub.end(); ++t)
+  for (ty_vector::iterator t=candidates.begin(); t!=candidates.end(); ++t)
   {
     if ((*t)->kind != ty_function)
       continue;
@@ -664,12 +667,202 @@ void sameApplications(app_list a, app_list b, testExactType te) {
     assert(equivalent(a.front()->getType(), b.front()->getType()));
 }
 
-app_list multimatch(env &e,
-                    types::overloaded *o,
-                    types::signature *source,
-                    arglist &al)
+// Calls with the same argument types to the same overloaded set of functions
+// resolve to the same functions, as long as the casts in the environment are
+// unchanged.  Such calls, to draw, label or operator *, say, are common in
+// the base modules.  The functions each call resolved to are remembered,
+// keyed by the id of the overloaded set and by the argument types, so that
+// a later call need only match its arguments against those functions.
+//
+// For the calls not yet resolved, large sets are also indexed by the number
+// of arguments and the type of the first, giving the few functions of the
+// set that might match such arguments exactly.
+class resolutionCache : public gc {
+  struct resolution {
+    size_t id;
+    signature *source;
+    size_t restPosition;
+    ty_vector chosen;
+  };
+
+#ifdef NOHASH
+  typedef mem::multimap<size_t, resolution> resolution_map;
+#else
+  typedef mem::unordered_multimap<size_t, resolution> resolution_map;
+#endif
+  typedef resolution_map::iterator resolution_iterator;
+
+  resolution_map resolutions;
+
+  struct candidates {
+    size_t id;
+    size_t arity;
+    size_t leading;
+    bool built;
+    ty_vector sub;
+  };
+
+#ifdef NOHASH
+  typedef mem::multimap<size_t, candidates> candidate_map;
+#else
+  typedef mem::unordered_multimap<size_t, candidates> candidate_map;
+#endif
+  typedef candidate_map::iterator candidate_iterator;
+
+  candidate_map index;
+
+  // Sets smaller than this are not indexed.
+  static const size_t minIndexed = 8;
+
+  // The changes to the casts in the environment when the cache was filled.
+  size_t specialChanges;
+
+  // The cache is emptied when it grows past this size.
+  static const size_t maxSize = 1 << 14;
+
+  static size_t hash(types::overloaded *o, signature *source) {
+    return o->id*2654435761U ^ source->hash();
+  }
+
+  // The position of the rest argument among the named arguments.
+  static size_t restPosition(arglist &al) {
+    return al.rest.val ? al.restPosition : 0;
+  }
+
+  // The hash of the type of the first argument, or 0 if there is none.
+  static size_t leading(signature *source) {
+    return source->formals.empty() ? 0 : source->formals[0].t->hash();
+  }
+
+  // Tests if a function could match arguments exactly, given their number and
+  // the hash of the type of the first: every formal without a default needs
+  // an argument, the first of which must be of the same type.
+  static bool mightMatch(ty *t, size_t arity, size_t leading)
+  {
+    if (t->kind != ty_function)
+      return false;
+    signature *sig = ((function *)t)->getSignature();
+    if (sig->isOpen)
+      return false;
+
+    formal_vector& formals = sig->formals;
+    if (arity > formals.size())
+      return false;
+    size_t required = 0;
+    for (size_t i = 0; i < formals.size(); ++i)
+      if (!formals[i].defval)
+        ++required;
+    if (required > arity)
+      return false;
+
+    return arity == 0 || formals[0].defval ||
+      formals[0].t->hash() == leading;
+  }
+
+public:
+  resolutionCache() : specialChanges(0) {}
+
+  // Calls with overloaded arguments, or arguments with errors, are not
+  // cached.
+  static bool cacheable(formal &f) {
+    return !f.t || (f.t->kind != ty_overloaded && f.t->kind != ty_error);
+  }
+  static bool cacheable(signature *source) {
+    for (size_t i = 0; i < source->formals.size(); ++i)
+      if (!cacheable(source->formals[i]))
+        return false;
+    return cacheable(source->getRest());
+  }
+
+  // Returns the functions chosen for the call, or 0 if it is not cached.
+  ty_vector *find(env &e, types::overloaded *o, signature *source,
+                  arglist &al)
+  {
+    if (specialChanges != e.ve.specialChanges()) {
+      resolutions.clear();
+      specialChanges = e.ve.specialChanges();
+      return 0;
+    }
+
+    size_t rp = restPosition(al);
+    std::pair<resolution_iterator, resolution_iterator> range =
+      resolutions.equal_range(hash(o, source));
+    for (resolution_iterator p = range.first; p != range.second; ++p) {
+      resolution &r = p->second;
+      if (r.id == o->id && r.restPosition == rp &&
+          argumentEquivalent(r.source, source))
+        return &r.chosen;
+    }
+    return 0;
+  }
+
+  // The functions of the set that might match the arguments exactly, in the
+  // order of the set.  The source must be cacheable.
+  ty_vector &exactCandidates(types::overloaded *o, signature *source)
+  {
+    if (o->sub.size() < minIndexed || source->hasRest())
+      return o->sub;
+
+    size_t arity = source->formals.size();
+    size_t lead = leading(source);
+    size_t h = o->id*2654435761U ^ (lead*31 + arity);
+    std::pair<candidate_iterator, candidate_iterator> range =
+      index.equal_range(h);
+    for (candidate_iterator p = range.first; p != range.second; ++p) {
+      candidates &c = p->second;
+      if (c.id == o->id && c.arity == arity && c.leading == lead) {
+        // Sets change often while a module is translated, so the candidates
+        // are only collected when the same kind of call is seen again.
+        if (!c.built) {
+          for (ty_vector::iterator t = o->sub.begin(); t != o->sub.end(); ++t)
+            if (mightMatch(*t, arity, lead))
+              c.sub.push_back(*t);
+          c.built = true;
+        }
+        return c.sub;
+      }
+    }
+
+    if (index.size() >= maxSize)
+      index.clear();
+
+    candidates c;
+    c.id = o->id;
+    c.arity = arity;
+    c.leading = lead;
+    c.built = false;
+    index.insert(std::make_pair(h, c));
+    return o->sub;
+  }
+
+  void store(types::overloaded *o, signature *source, arglist &al,
+             app_list &l)
+  {
+    if (resolutions.size() >= maxSize)
+      resolutions.clear();
+
+    resolution r;
+    r.id = o->id;
+    r.source = source;
+    r.restPosition = restPosition(al);
+    for (app_list::iterator a = l.begin(); a != l.end(); ++a)
+      r.chosen.push_back((*a)->getType());
+    resolutions.insert(std::make_pair(hash(o, source), r));
+  }
+};
+
+// The resolution of a call, without the cache of resolutions, but using its
+// index of candidates if given.
+app_list uncachedMultimatch(env &e,
+                            types::overloaded *o,
+                            types::signature *source,
+                            arglist &al,
+                            resolutionCache *cache=0)
 {
-  app_list a = exactMultimatch(e, o, source, al);
+  app_list a = exactMultimatch(e,
+                               cache ? cache->exactCandidates(o, source) :
+                                       o->sub,
+                               source, al);
   if (!a.empty()) {
 #if DEBUG_CACHE
     // Make sure that exactMultimatch and the fallback return the same
@@ -693,4 +886,36 @@ app_list multimatch(env &e,
   return inexactMultimatch(e, o, source, al);
 }
 
+app_list multimatch(env &e,
+                    types::overloaded *o,
+                    types::signature *source,
+                    arglist &al)
+{
+  if (!resolutionCache::cacheable(source))
+    return uncachedMultimatch(e, o, source, al);
+
+  if (!e.resolutions)
+    e.resolutions = new resolutionCache;
+  resolutionCache &cache = *e.resolutions;
+
+  ty_vector *chosen = cache.find(e, o, source, al);
+  if (chosen) {
+    app_list l;
+    for (ty_vector::iterator t = chosen->begin(); t != chosen->end(); ++t) {
+      application *a = application::match(e, (function *)*t, source, al);
+      assert(a);
+      l.push_back(a);
+    }
+#if DEBUG_CACHE
+    sameApplications(l, uncachedMultimatch(e, o, source, al),
+                     DONT_TEST_EXACT);
+#endif
+    return l;
+  }
+
+  app_list l = uncachedMultimatch(e, o, source, al, &cache);
+  cache.store(o, source, al, l);
+  return l;
+}
+
 } // namespace trans
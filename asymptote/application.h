@@ -89,15 +89,20 @@ struct restArg : public gc {
   mem::list<arg *> inits;
 
   arg *rest;
+
+  // The type of the cells of the array, if known.
+  types::ty *celltype;
 public:
-  restArg()
-    : rest(0) {}
+  restArg(types::ty *celltype=0)
+    : rest(0), celltype(celltype) {}
 
   virtual ~restArg() 
   {}
 
-  // Encodes the instructions to make an array from size elements on the stack.
-  static void transMaker(coenv &e, Int size, bool rest);
+  // Encodes the instructions to make an array from size elements of type
+  // celltype on the stack.
+  static void transMaker(coenv &e, Int size, bool rest,
+                         types::ty *celltype);
 
   void trans(coenv &e, temp_vector &temps);
 
@@ -7,9 +7,96 @@
 
 #include "array.h"
 #include "mod.h"
+#include "parallel.h"
 
 namespace vm {
 
+void array::init(size_t n, const item& i)
+{
+  if(n > 0) {
+    reallocate(n);
+    std::uninitialized_fill(data(),data()+n,i);
+    b->size=n;
+  }
+}
+
+void array::reallocate(size_t capacity)
+{
+  item_allocator allocator(isAtomic);
+  buffer *old=b;
+  item *from=data();
+  size_t n=size();
+
+  // The count of sharers is itself shared, so a thread running alongside
+  // others leaves the copy to the calling thread.
+  if(old && old->sharers > 0)
+    parallel::serial();
+
+  b=reinterpret_cast<buffer *>(allocator.allocate(capacity+headerItems));
+  b->sharers=0;
+  b->size=n;
+  b->capacity=capacity;
+  std::uninitialized_copy(from,from+n,data());
+
+  if(old) {
+    if(old->sharers > 0)
+      --old->sharers;
+    else
+      allocator.deallocate(reinterpret_cast<item *>(old),
+                           old->capacity+headerItems);
+  }
+}
+
+size_t array::grow(size_t n) const
+{
+  size_t twice=2*capacity();
+  return n > twice ? n : twice;
+}
+
+array& array::operator= (const array& a)
+{
+  if(b != a.b) {
+    clear();
+    b=a.b;
+    if(b) share();
+  }
+  cycle=a.cycle;
+  isAtomic=a.isAtomic;
+  return *this;
+}
+
+void array::resize(size_t n, item i)
+{
+  size_t len=size();
+  if(n > capacity())
+    reallocate(grow(n));
+  else
+    unshare();
+  if(b) {
+    if(n > len)
+      std::uninitialized_fill(data()+len,data()+n,i);
+    b->size=n;
+  }
+}
+
+void array::clear()
+{
+  if(b && b->sharers > 0) {
+    parallel::serial();
+    --b->sharers;
+    b=0;
+  } else if(b)
+    b->size=0;
+}
+
+array::iterator array::insert(iterator p, const item& i)
+{
+  item copy=i;
+  size_t k=p-data();
+  insert(p,&copy,&copy+1);
+  return data()+k;
+}
+
 inline void checkBackSlice(Int left, Int right)
 {
   if (right < left)
@@ -32,20 +119,20 @@ inline size_t sliceIndex(Int in, size_t len) {
   return index < len ? index : len;
 }
 
-array *array::slice(Int left, Int right)
+array *array::slice(Int left, Int right) const
 {
   checkBackSlice(left, right);
 
   if (left == right)
-    return new array();
+    return new array(0,atomic());
 
   size_t length=size();
   if (length == 0)
-    return new array();
+    return new array(0,atomic());
 
   if (cycle) {
     size_t resultLength = (size_t)(right - left);
-    array *result = new array(resultLength);
+    array *result = new array(resultLength,atomic());
 
     size_t i = (size_t)imod(left, length), ri = 0;
     while (ri < resultLength) {
@@ -63,8 +150,15 @@ array *array::slice(Int left, Int right)
     size_t l = sliceIndex(left, length);
     size_t r = sliceIndex(right, length);
 
+    if (l == 0 && r == length) {
+      // A slice of the whole array shares its storage.
+      array *result = new array(*this);
+      result->cycle = false;
+      return result;
+    }
+
     size_t resultLength = r - l;
-    array *result = new array(resultLength);
+    array *result = new array(resultLength,atomic());
 
     std::copy(this->begin()+l, this->begin()+r, result->begin());
 
@@ -72,7 +166,7 @@ array *array::slice(Int left, Int right)
   }
 }
 
-void array::setNonBridgingSlice(size_t l, size_t r, mem::vector<item> *a)
+void array::setNonBridgingSlice(size_t l, size_t r, const array *a)
 {
   assert(0 <= l);
   assert(l <= r);
@@ -97,7 +191,7 @@ void array::setNonBridgingSlice(size_t l, size_t r, mem::vector<item> *a)
   }
 }
 
-void array::setBridgingSlice(size_t l, size_t r, mem::vector<item> *a)
+void array::setBridgingSlice(size_t l, size_t r, const array *a)
 {
   size_t len=this->size();
 
@@ -113,8 +207,9 @@ void array::setSlice(Int left, Int right, array *a)
   checkBackSlice(left, right);
 
   // If we are slicing an array into itself, slice in a copy instead, to ensure
-  // the proper result.
-  mem::vector<item> *v = (a == this) ? new mem::vector<item>(*a) : a;
+  // the proper result.  The same is needed for an array sharing our storage,
+  // as that storage is about to be changed.
+  const array *v = shares(a) ? new array(*a) : a;
 
   size_t length=size();
   if (cycle) {
@@ -166,6 +261,9 @@ array *array::copyToDepth(size_t depth)
 {
   if (depth == 0) {
     return this;
+  } else if (depth == 1) {
+    // The copy shares our storage until either array is changed.
+    return new array(*this);
   } else {
     size_t n=this->size();
     array *a=new array(n);
@@ -179,8 +277,9 @@ array *array::copyToDepth(size_t depth)
 }
 
 array::array(size_t n, item i, size_t depth)
-  : mem::vector<item>(n), cycle(false)
+  : b(0), cycle(false), isAtomic(false)
 {
+  init(n,item());
   for (size_t k=0; k<n; ++k)
     (*this)[k] = copyItemToDepth(i, depth);
 }
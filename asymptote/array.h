@@ -14,21 +14,184 @@
 
 namespace vm {
 
-// Arrays are vectors with push and pop functions.
-class array : public mem::vector<item> {
-  bool cycle;  
+typedef mem::atomic_allocator<item> item_allocator;
 
-  void setNonBridgingSlice(size_t l, size_t r, mem::vector<item> *a);
-  void setBridgingSlice(size_t l, size_t r, mem::vector<item> *a);
+// Arrays are vectors with push and pop functions.  An array created as atomic
+// only ever holds items of a pointerFree type, so its storage is not scanned
+// by the collector.
+//
+// Copies of an array share its storage until one of them is changed: every
+// member that can change the items, including the non-const accessors, first
+// calls unshare(), so reading an array through a const pointer never copies
+// it.  As the collector does not tell us when a copy dies, the count of
+// sharers may be too high, which only costs an unnecessary copy.
+class array : public gc {
+  // The storage begins with this header, followed by the items.
+  struct buffer {
+    size_t sharers; // The number of arrays using the storage, besides one.
+    size_t size;
+    size_t capacity;
+  };
+  static const size_t headerItems=(sizeof(buffer)+sizeof(item)-1)/sizeof(item);
+
+  buffer *b; // Null until the array first holds items.
+  bool cycle;
+  bool isAtomic;
+
+  item *data() const {
+    return b ? reinterpret_cast<item *>(b)+headerItems : 0;
+  }
+
+  // Moves the items to new storage of the given capacity.
+  void reallocate(size_t capacity);
+  size_t grow(size_t n) const;
+
+  // Counts another array sharing the storage.  Threads running parallelmap
+  // may copy one array at once, so the count is raised atomically; it is
+  // lowered only by code run serially.
+  void share()
+  {
+#ifdef HAVE_PTHREAD
+    __sync_fetch_and_add(&b->sharers,1);
+#else
+    ++b->sharers;
+#endif
+  }
+
+  void unshare()
+  {
+    if(b && b->sharers > 0)
+      reallocate(size());
+  }
+
+  void init(size_t n, const item& i);
+  void setNonBridgingSlice(size_t l, size_t r, const array *a);
+  void setBridgingSlice(size_t l, size_t r, const array *a);
 public:
-  array() : cycle(false) {}
+  typedef item value_type;
+  typedef size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef item& reference;
+  typedef const item& const_reference;
+  typedef item *iterator;
+  typedef const item *const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  array() : b(0), cycle(false), isAtomic(false) {}
   
   array(size_t n)
-    : mem::vector<item>(n), cycle(false)
-  {}
+    : b(0), cycle(false), isAtomic(false)
+  {
+    init(n,item());
+  }
+
+  array(size_t n, bool atomic)
+    : b(0), cycle(false), isAtomic(atomic)
+  {
+    init(n,item());
+  }
 
   array(size_t n, item i, size_t depth);
 
+  // A copy that shares the storage of a.
+  array(const array& a) : b(a.b), cycle(a.cycle), isAtomic(a.isAtomic)
+  {
+    if(b) share();
+  }
+
+  array& operator= (const array& a);
+
+  // Whether a shares the storage of this array.
+  bool shares(const array *a) const {
+    return b && b == a->b;
+  }
+
+  size_t size() const {return b ? b->size : 0;}
+  bool empty() const {return size() == 0;}
+  size_t capacity() const {return b ? b->capacity : 0;}
+
+  const_reference operator[] (size_t i) const {return data()[i];}
+  const_reference front() const {return data()[0];}
+  const_reference back() const {return data()[size()-1];}
+  const_iterator begin() const {return data();}
+  const_iterator end() const {return data()+size();}
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  reference operator[] (size_t i) {unshare(); return data()[i];}
+  reference front() {unshare(); return data()[0];}
+  reference back() {unshare(); return data()[size()-1];}
+  iterator begin() {unshare(); return data();}
+  iterator end() {unshare(); return data()+size();}
+  reverse_iterator rbegin() {return reverse_iterator(end());}
+  reverse_iterator rend() {return reverse_iterator(begin());}
+
+  void push_back(const item& i)
+  {
+    if(!b || b->sharers > 0 || b->size == b->capacity) {
+      item copy=i; // In case i is one of our items.
+      reallocate(grow(size()+1));
+      new(data()+b->size) item(copy);
+    } else
+      new(data()+b->size) item(i);
+    ++b->size;
+  }
+
+  void pop_back()
+  {
+    unshare();
+    --b->size;
+  }
+
+  void resize(size_t n, item i=item());
+
+  void reserve(size_t n)
+  {
+    if(n > capacity())
+      reallocate(n);
+  }
+
+  void clear();
+
+  // As for a vector, the iterators given must not point into this array.
+  iterator insert(iterator p, const item& i);
+
+  template <typename InputIterator>
+  void insert(iterator p, InputIterator first, InputIterator last)
+  {
+    size_t n=std::distance(first,last);
+    if(n == 0)
+      return;
+    size_t k=p-data();
+    size_t len=size();
+    if(len+n > capacity())
+      reallocate(grow(len+n));
+    item *d=data();
+    std::uninitialized_fill(d+len,d+len+n,item());
+    std::copy_backward(d+k,d+len,d+len+n);
+    std::copy(first,last,d+k);
+    b->size += n;
+  }
+
+  iterator erase(iterator p)
+  {
+    std::copy(p+1,end(),p);
+    --b->size;
+    return p;
+  }
+
+  iterator erase(iterator first, iterator last)
+  {
+    std::copy(last,end(),first);
+    b->size -= last-first;
+    return first;
+  }
+
   void push(item i)
   {
     push_back(i);
@@ -47,7 +210,27 @@ public:
     return get<T>((*this)[i]);
   }
   
-  array *slice(Int left, Int right);
+  // The items of an array of a packable type T, as packed values that a loop
+  // can read directly.  Throws bad_item_value if any item is unset.
+  template <typename T>
+  const T *values() const
+  {
+    // Fails to compile unless an item is a T.
+    typedef char packed[sizeof(T) == sizeof(item) && packable<T>::value ?
+                        1 : -1];
+    (void) sizeof(packed);
+    const item *d=data();
+    for(size_t i=0, n=size(); i < n; ++i)
+      if(d[i].empty())
+        throw bad_item_value();
+    return reinterpret_cast<const T *>(d);
+  }
+
+  bool atomic() const {
+    return isAtomic;
+  }
+
+  array *slice(Int left, Int right) const;
   void setSlice(Int left, Int right, array *a);
 
   void cyclic(bool b) {
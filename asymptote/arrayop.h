@@ -14,6 +14,7 @@
 #include "fileio.h"
 #include "callable.h"
 #include "mathop.h"
+#include "parallel.h"
 
 namespace run {
 
@@ -25,50 +26,76 @@ using camp::tab;
 vm::array *copyArray(vm::array *a);
 vm::array *copyArray2(vm::array *a);
   
+// Reads the cells of an array of T.  Arrays of packable types are read as
+// packed values, checked once, so that elementwise loops over them have no
+// branches and can be vectorized.
+template<class T, bool packed=vm::packable<T>::value>
+class cells {
+  const array *a;
+public:
+  cells(const array *a) : a(a) {}
+  T operator[] (size_t i) const {return read<T>(a,i);}
+};
+
+template<class T>
+class cells<T,true> {
+  const T *v;
+public:
+  cells(const array *a) : v(a->values<T>()) {}
+  T operator[] (size_t i) const {return v[i];}
+};
+
 template<class T, class U, template <class S> class op>
 void arrayOp(vm::stack *s)
 {
   U b=pop<U>(s);
-  array *a=pop<array*>(s);
+  const array *a=pop<array*>(s);
   size_t size=checkArray(a);
-  array *c=new array(size);
+  array *c=new array(size,vm::pointerFree<T>::value);
+  cells<T> A(a);
+  vm::item *C=c->begin();
   for(size_t i=0; i < size; i++)
-    (*c)[i]=op<T>()(read<T>(a,i),b,i);
+    C[i]=op<T>()(A[i],b,i);
   s->push(c);
 }
 
 template<class T, class U, template <class S> class op>
 void opArray(vm::stack *s)
 {
-  array *a=pop<array*>(s);
+  const array *a=pop<array*>(s);
   T b=pop<T>(s);
   size_t size=checkArray(a);
-  array *c=new array(size);
+  array *c=new array(size,vm::pointerFree<U>::value);
+  cells<U> A(a);
+  vm::item *C=c->begin();
   for(size_t i=0; i < size; i++)
-    (*c)[i]=op<U>()(b,read<U>(a,i),i);
+    C[i]=op<U>()(b,A[i],i);
   s->push(c);
 }
 
 template<class T, template <class S> class op>
 void arrayArrayOp(vm::stack *s)
 {
-  array *b=pop<array*>(s);
-  array *a=pop<array*>(s);
+  const array *b=pop<array*>(s);
+  const array *a=pop<array*>(s);
   size_t size=checkArrays(a,b);
-  array *c=new array(size);
+  array *c=new array(size,vm::pointerFree<T>::value);
+  cells<T> A(a), B(b);
+  vm::item *C=c->begin();
   for(size_t i=0; i < size; i++)
-    (*c)[i]=op<T>()(read<T>(a,i),read<T>(b,i),i);
+    C[i]=op<T>()(A[i],B[i],i);
   s->push(c);
 }
 
 template<class T>
 void sumArray(vm::stack *s)
 {
-  array *a=pop<array*>(s);
+  const array *a=pop<array*>(s);
   size_t size=checkArray(a);
+  cells<T> A(a);
   T sum=0;
   for(size_t i=0; i < size; i++)
-    sum += read<T>(a,i);
+    sum += A[i];
   s->push(sum);
 }
 
@@ -147,7 +174,7 @@ void array2Op(vm::stack *s)
   for(size_t i=0; i < size; ++i) {
     array *ai=read<array*>(a,i);
     size_t aisize=checkArray(ai);
-    array *ci=new array(aisize);
+    array *ci=new array(aisize,vm::pointerFree<T>::value);
     (*c)[i]=ci;
     for(size_t j=0; j < aisize; j++)
       (*ci)[j]=op<T>()(read<T>(ai,j),b,0);
@@ -165,7 +192,7 @@ void opArray2(vm::stack *s)
   for(size_t i=0; i < size; ++i) {
     array *ai=read<array*>(a,i);
     size_t aisize=checkArray(ai);
-    array *ci=new array(aisize);
+    array *ci=new array(aisize,vm::pointerFree<U>::value);
     (*c)[i]=ci;
     for(size_t j=0; j < aisize; j++)
       (*ci)[j]=op<U>()(read<U>(ai,j),b,0);
@@ -184,7 +211,7 @@ void array2Array2Op(vm::stack *s)
     array *ai=read<array*>(a,i);
     array *bi=read<array*>(b,i);
     size_t aisize=checkArrays(ai,bi);
-    array *ci=new array(aisize);
+    array *ci=new array(aisize,vm::pointerFree<T>::value);
     (*c)[i]=ci;
     for(size_t j=0; j < aisize; j++)
       (*ci)[j]=op<T>()(read<T>(ai,j),read<T>(bi,j),0);
@@ -233,7 +260,7 @@ void diagonal(vm::stack *s)
   size_t n=checkArray(a);
   array *c=new array(n);
   for(size_t i=0; i < n; ++i) {
-    array *ci=new array(n);
+    array *ci=new array(n,vm::pointerFree<T>::value);
     (*c)[i]=ci;
     for(size_t j=0; j < i; ++j)
       (*ci)[j]=T();
@@ -256,7 +283,7 @@ template<class T>
 void sortArray(vm::stack *s)
 {
   array *c=copyArray(pop<array*>(s));
-  sort(c->begin(),c->end(),compare<T>());
+  std::sort(c->begin(),c->end(),compare<T>());
   s->push(c);
 }
 
@@ -283,7 +310,7 @@ template<class T>
 void sortArray2(vm::stack *s)
 {
   array *c=copyArray(pop<array*>(s));
-  stable_sort(c->begin(),c->end(),compare2<T>());
+  std::stable_sort(c->begin(),c->end(),compare2<T>());
   s->push(c);
 }
 
@@ -471,14 +498,55 @@ void writeArray3(vm::stack *s)
   f->flush();
 }
 
+// The arguments and results of an elementwise function of an array.
+template <class S>
+struct elements {
+  cells<S> a;
+  vm::item *c;
+  elements(const array *a, array *c) : a(a), c(c->begin()) {}
+};
+
+template <class T, class S, T (*func)(S)>
+void mapElements(void *data, size_t begin, size_t end)
+{
+  const cells<S>& a=((elements<S> *) data)->a;
+  vm::item *c=((elements<S> *) data)->c;
+  for(size_t i=begin; i < end; ++i)
+    c[i]=func(a[i]);
+}
+
 template <class T, class S, T (*func)(S)>
 void arrayFunc(vm::stack *s) 
 {
-  array *a=pop<array*>(s);
+  const array *a=pop<array*>(s);
   size_t size=checkArray(a);
-  array *c=new array(size);
-  for(size_t i=0; i < size; i++)
-    (*c)[i]=func(read<S>(a,i));
+  array *c=new array(size,vm::pointerFree<T>::value);
+  if(size > 0) {
+    elements<S> e(a,c);
+    mapElements<T,S,func>(&e,0,size);
+  }
+  s->push(c);
+}
+
+// Elementwise functions of arrays longer than this are worth splitting
+// between threads.
+const size_t threadGrain=16384;
+
+// Like arrayFunc, for a function that is safe to call on several threads
+// at once: one that neither allocates nor reports errors or warnings.
+template <class T, class S, T (*func)(S)>
+void concurrentArrayFunc(vm::stack *s)
+{
+  const array *a=pop<array*>(s);
+  size_t size=checkArray(a);
+  array *c=new array(size,vm::pointerFree<T>::value);
+  if(size > 0) {
+    elements<S> e(a,c);
+    size_t threads=size < 2*threadGrain || !vm::pointerFree<T>::value ? 1 :
+      parallel::threads(size,threadGrain,
+                        settings::getSetting<Int>("arraythreads"));
+    parallel::run(mapElements<T,S,func>,&e,size,threads);
+  }
   s->push(c);
 }
 
@@ -491,7 +559,7 @@ void arrayFunc2(vm::stack *s)
   for(size_t i=0; i < size; ++i) {
     array *ai=read<array*>(a,i);
     size_t aisize=checkArray(ai);
-    array *ci=new array(aisize);
+    array *ci=new array(aisize,vm::pointerFree<T>::value);
     (*c)[i]=ci;
     for(size_t j=0; j < aisize; j++)
     (*ci)[j]=func(read<S>(ai,j));
@@ -538,7 +606,7 @@ inline void copyArrayC(T* &dest, const vm::array *a, T (*cast)(A),
 template<typename T>
 inline vm::array* copyCArray(const size_t n, const T* p)
 {
-  vm::array* a = new vm::array(n);
+  vm::array* a = new vm::array(n,vm::pointerFree<T>::value);
   for(size_t i=0; i < n; ++i) (*a)[i] = p[i];
   return a;
 }
@@ -574,7 +642,7 @@ inline vm::array* copyCArray2(const size_t n, const size_t m, const T* p)
 {
   vm::array* a=new vm::array(n);
   for(size_t i=0; i < n; ++i) {
-    array *ai=new array(m);
+    array *ai=new array(m,vm::pointerFree<T>::value);
     (*a)[i]=ai;
     for(size_t j=0; j < m; ++j) 
       (*ai)[j]=p[m*i+j];
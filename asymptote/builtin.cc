@@ -220,11 +220,27 @@ void addRealFunc0(venv &ve, bltin fcn, symbol name)
   addFunc(ve, fcn, primReal(), name);
 }
 
+// The native entry point of realReal<fcn>.
+template<double (*fcn)(double)>
+struct realRealNative {
+  static void direct(item *args) {
+    args[0]=fcn(get<double>(args[0]));
+  }
+  static const nativeEntry table[];
+};
+
+template<double (*fcn)(double)>
+const nativeEntry realRealNative<fcn>::table[] = {
+  {realReal<fcn>, realRealNative<fcn>::direct, 1},
+  {0, 0, 0}
+};
+
 template<double (*fcn)(double)>
 void addRealFunc(venv &ve, symbol name)
 {
+  registerNatives(realRealNative<fcn>::table);
   addFunc(ve, realReal<fcn>, primReal(), name, formal(primReal(),SYM(x)));
-  addFunc(ve, arrayFunc<double,double,fcn>, realArray(), name,
+  addFunc(ve, concurrentArrayFunc<double,double,fcn>, realArray(), name,
           formal(realArray(),SYM(a)));
 }
 
@@ -629,6 +645,9 @@ void addArrayOps(venv &ve, types::array *t)
 
   addFunc(ve, run::arrayFunction,
           t, SYM(map), formal(new function(ct, ct), SYM(f)), formal(t, SYM(a)));
+  addFunc(ve, run::arrayParallelFunction,
+          t, SYM(parallelmap), formal(new function(ct, ct), SYM(f)),
+          formal(t, SYM(a)), formal(primInt(), SYM(threads), true));
   
   addFunc(ve, run::arraySequence,
           t, SYM(sequence), formal(new function(ct, primInt()), SYM(f)),
@@ -715,13 +734,6 @@ void addOperators(venv &ve)
   addBinOps<triple,maxbound>(ve,primTriple(),tripleArray(),tripleArray2(),
                              tripleArray3(),SYM(maxbound));
   
-  addFunc(ve,arrayFunc<double,pair,abs>,realArray(),SYM(abs),
-          formal(pairArray(),SYM(a)));
-  addFunc(ve,arrayFunc<double,triple,abs>,realArray(),SYM(abs),
-          formal(tripleArray(),SYM(a)));
-  
-  addFunc(ve,arrayFunc<pair,pair,conjugate>,pairArray(),SYM(conj),
-          formal(pairArray(),SYM(a)));
   addFunc(ve,arrayFunc2<pair,pair,conjugate>,pairArray2(),SYM(conj),
           formal(pairArray2(),SYM(a)));
   
@@ -30,10 +30,7 @@ bool func::compare(callable* F)
 }
 
 void func::print(ostream& out) {
-  out << "func with lambda";
-#ifdef DEBUG_FRAME
-  out << " " << body->name;
-#endif
+  out << "func with lambda " << body->name;
 }
 
 bool bfunc::compare(callable* F)
@@ -44,10 +41,7 @@ bool bfunc::compare(callable* F)
 }
 
 void bfunc::print(ostream& out) {
-  out << "bltin";
-#ifdef DEBUG_BLTIN
-  out << " " << lookupBltin(func);
-#endif
+  out << "bltin " << lookupBltin(func);
 }
 
 void thunk::call(stack *s)
@@ -11,6 +11,7 @@
 #include "common.h"
 #include "item.h"
 #include "inst.h"
+#include "sampler.h"
 
 namespace vm {
 
@@ -55,7 +56,11 @@ class bfunc : public callable
 {
 public:
   bfunc(bltin b) : func(b) {}
-  virtual void call (stack *s) { func(s); }
+  virtual void call (stack *s) {
+    sampler::enter(func);
+    func(s);
+    sampler::leave();
+  }
   virtual bool compare(callable*);
 
   void print(ostream& out);
@@ -14,6 +14,8 @@
 #include "genv.h"
 #include "entry.h"
 #include "builtin.h"
+#include "peephole.h"
+#include "settings.h"
 
 using namespace sym;
 using namespace types;
@@ -28,9 +30,7 @@ function *bootuptype();
 vm::lambda *newLambda(string name) {
   assert(!name.empty());
   vm::lambda *l = new vm::lambda;
-#ifdef DEBUG_FRAME
   l->name = name;
-#endif
   return l;
 }
 
@@ -62,7 +62,13 @@ coder::coder(position pos, string name, function *t, coder *parent,
              modifier sord, bool reframe)
   : level(reframe ? new frame(name,
                               parent->getFrame(),
-                              t->sig.getNumFormals()) :
+                              t->sig.getNumFormals(),
+#if SIMPLE_FRAME
+                              false
+#else
+                              true
+#endif
+                              ) :
                     parent->getFrame()),
     recordLevel(parent->recordLevel),
     recordType(parent->recordType),
@@ -134,6 +140,15 @@ void assertBltinLookup(inst::opcode op, item it)
 #endif
 
 
+void coder::encodeBuiltin(vm::bltin f)
+{
+  const vm::nativeEntry *n = settings::peephole ? vm::lookupNative(f) : 0;
+  if (n)
+    encode(inst::native, n);
+  else
+    encode(inst::builtin, f);
+}
+
 void coder::encodePop()
 {
   if (isStatic() && !isTopLevel()) {
@@ -195,7 +210,7 @@ bool coder::encode(frame *dest, frame *top)
         return false;
       }
 
-      encode(inst::fieldpush, level->parentIndex());
+      encode(inst::fieldpush, level->linkIndex());
 
       level = level->getParent();
     }
@@ -334,12 +349,23 @@ vm::lambda *coder::close() {
   if (funtype->result->kind == types::ty_void)
     encode(inst::ret);
 
+  if (settings::peephole)
+    vm::optimize(program);
+
   l->code = program;
 
   l->parentIndex = level->parentIndex();
 
   l->framesize = level->size();
 
+  if (level->onStack()) {
+    l->closuresize = level->closureSize();
+    l->escaping.resize(l->closuresize-1);
+    for (Int i = 0; i < level->size(); ++i)
+      if (level->escaped(i))
+        l->escaping[level->closureIndex(i)-1] = i;
+  }
+
   sord_stack.pop();
   sord = sord_stack.top();
 
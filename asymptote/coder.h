@@ -263,17 +263,19 @@ public:
 
   // The encode functions add instructions and operands on to the code array.
 private:
-  void encode(inst i)
+  vm::program::label encode(inst i)
   {
     i.pos = curPos;
     // Static code is put into the enclosing coder, unless we are translating a
     // codelet.
     if (isStatic() && !isTopLevel()) {
       assert(parent);
-      parent->encode(i);
+      return parent->encode(i);
     }
     else {
+      vm::program::label l = program->end();
       program->encode(i);
+      return l;
     }
   }
 
@@ -286,15 +288,20 @@ public:
     inst i; i.op = op; i.pos = nullPos;
     encode(i);
   }
-  void encode(inst::opcode op, item it)
+  // Returns the location of the instruction.
+  vm::program::label encode(inst::opcode op, item it)
   {
 #ifdef DEBUG_BLTIN
     assertBltinLookup(op, it);
 #endif
     inst i; i.op = op; i.pos = nullPos; i.ref = it;
-    encode(i);
+    return encode(i);
   }
 
+  // Encodes a call to a builtin, through its native entry point if it has
+  // one.
+  void encodeBuiltin(vm::bltin f);
+
   // Encodes a pop instruction, or merges the pop into the previous
   // instruction (ex. varsave+pop becomes varpop).
   void encodePop();
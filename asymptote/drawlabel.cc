@@ -11,6 +11,9 @@
 #include "settings.h"
 #include "util.h"
 #include "lexical.h"
+#include "labelcache.h"
+#include "picture.h"
+#include "parallel.h"
 
 using namespace settings;
 
@@ -74,6 +77,15 @@ void texdim(iopipestream& tex, double& dest,
   wait(tex,"\n*",abort);
 }
 
+void sizewarning(const string& s)
+{
+  if(getSetting<bool>("debug")) {
+    ostringstream buf;
+    buf << "Cannot determine size of label \"" << s << "\"";
+    reportWarning(buf);
+  }
+}
+
 bool texbounds(double& width, double& height, double& depth,
                iopipestream& tex, string& s, const char **abort, bool warn,
                bool Inline)
@@ -86,12 +98,8 @@ bool texbounds(double& width, double& height, double& depth,
     tex << "\\show 0\n";
     tex.wait("\n*");
 
-    if(warn && getSetting<bool>("debug")) {
-      ostringstream buf;
-      buf << "Cannot determine size of label \"" << s << "\"";
-      reportWarning(buf);
-    }
-
+    if(warn)
+      sizewarning(s);
     return false;
   }
 
@@ -102,6 +110,223 @@ bool texbounds(double& width, double& height, double& depth,
   return true;
 }   
 
+// Labels are sent to TeX in chunks of at most texchunk labels, written
+// before TeX's reply is read.  TeX has read all that was sent before when a
+// chunk is written, so a chunk no longer than texchunkbytes, a page, which
+// any pipe holds, is written without waiting for TeX, however much TeX
+// writes back.  A longer label is sent in a chunk of its own.
+static const size_t texchunk=64;
+static const size_t texchunkbytes=4096;
+
+static const string texpentag="ASYpen:";
+static const string texboxtag="ASYbox:";
+static const string texendtag="ASYend";
+
+// Reads the index and dimensions of a label from a line that TeX wrote for
+// a box, such as ASYbox:3:12.5pt:6.83331pt:0.0pt.
+bool texdims(const string& line, size_t& i, double& width, double& height,
+             double& depth)
+{
+  string s=line.substr(texboxtag.size());
+  for(size_t j=0; j < s.size(); ++j)
+    if(s[j] == ':') s[j]=' ';
+  istringstream in(s);
+  string wd,ht,dp;
+  if(!(in >> i >> width >> wd >> height >> ht >> depth >> dp) ||
+     wd != "pt" || ht != "pt" || dp != "pt")
+    return false;
+  width *= tex2ps;
+  height *= tex2ps;
+  depth *= tex2ps;
+  return true;
+}
+
+// Reads what TeX writes in reply to the labels start to end-1 of a batch,
+// up to the prompt that follows the blank line ending the chunk (earlier
+// prompts may be left from the preamble).  Each label whose box TeX reports
+// without an error in between is measured.  Returns the messages of the
+// errors to be reported, in the order of the labels: those in setting the
+// font of a label, those in setting a label unless Inline, and a fatal one.
+string texdims(iopipestream& tex, texlabels& labels, size_t start, size_t end,
+               const mem::vector<bool>& newpen, const char **abort,
+               bool Inline)
+{
+  size_t naborts=0;
+  while(abort[naborts]) ++naborts;
+  
+  string reply;
+  string errors;
+  size_t pos=0;
+  size_t error=string::npos; // Where the first error message for next starts.
+  size_t next=start;         // The label TeX is setting.
+  bool penset=false;         // Whether the font of next has been set.
+  bool fonterror=false;      // Whether TeX reported an error in the font.
+  bool ended=false;
+  
+  for(;;) {
+    string s;
+    tex >> s;
+    if(s.empty() && !tex.running()) break;
+    reply += s;
+    
+    size_t eol;
+    while((eol=reply.find('\n',pos)) != string::npos) {
+      size_t begin=pos;
+      string line=reply.substr(begin,eol-begin);
+      pos=eol+1;
+      // Handle MSDOS line endings.
+      if(!line.empty() && line[line.size()-1] == '\r')
+        line.erase(line.size()-1);
+      if(line.compare(0,texboxtag.size(),texboxtag) == 0) {
+        size_t i;
+        double width,height,depth;
+        if(texdims(line,i,width,height,depth) && i >= start && i < end) {
+          if(i == next) {
+            texlabel& l=labels[i];
+            if(error != string::npos) {
+              l.failed=true;
+              if(fonterror || !Inline)
+                errors += reply.substr(error,begin-error);
+            } else {
+              l.width=width;
+              l.height=height;
+              l.depth=depth;
+              l.measured=true;
+            }
+          }
+          next=i+1;
+          error=string::npos;
+          penset=fonterror=false;
+        }
+        continue;
+      }
+      if(line.compare(0,texpentag.size(),texpentag) == 0) {
+        penset=true;
+        continue;
+      }
+      if(line == texendtag) {
+        ended=true;
+        continue;
+      }
+      for(size_t k=0; k < naborts; ++k) {
+        if(line.compare(0,strlen(abort[k]),abort[k]) == 0) {
+          if(error == string::npos) error=begin;
+          if(fataltex[k]) {
+            tex.pipeclose();
+            return errors+reply.substr(error);
+          }
+          if(next < end && newpen[next-start] && !penset)
+            fonterror=true;
+          break;
+        }
+      }
+    }
+    if(ended && tex.tailequals(reply.c_str(),reply.size(),texready.c_str(),
+                               texready.size()))
+      break;
+  }
+  
+  // An error after which TeX did not report the box.
+  if(error != string::npos && (fonterror || !Inline))
+    errors += reply.substr(error);
+  return errors;
+}
+
+// Writes a chunk of the labels start to end-1 of a batch to TeX, with the
+// commands setting their fonts, noting which of them needed any.  Returns
+// the end of the chunk.
+size_t texsend(iopipestream& tex, pen& lastpen, const texlabels& labels,
+               size_t start, size_t end, mem::vector<bool>& newpen, bool Latex)
+{
+  newpen.clear();
+  string chunk;
+  size_t i=start;
+  for(; i < end; ++i) {
+    const texlabel& l=labels[i];
+    ostringstream buf;
+    bool set=Latex && setlatexfont(buf,l.p,lastpen);
+    if(settexfont(buf,l.p,lastpen,Latex))
+      set=true;
+    if(set)
+      buf << "\\immediate\\write16{" << texpentag << i << "}" << newl;
+    buf << "\\setbox\\ASYbox=\\hbox{" << stripblanklines(l.s) << "}" << newl
+        << "\\immediate\\write16{" << texboxtag << i
+        << ":\\the\\wd\\ASYbox:\\the\\ht\\ASYbox:\\the\\dp\\ASYbox}"
+        << newl;
+    string s=buf.str();
+    if(i > start && chunk.size()+s.size() > texchunkbytes)
+      break;
+    chunk += s;
+    lastpen=l.p;
+    newpen.push_back(set);
+  }
+  ostringstream buf;
+  buf << "\\immediate\\write16{" << texendtag << "}" << newl << newl;
+  tex << chunk+buf.str();
+  return i;
+}
+
+// The part of a batch of labels measured by one TeX pipe.
+struct texshard {
+  iopipestream *tex;
+  pen *lastpen;       // The pen of the last label the pipe set.
+  size_t next,end;    // The labels left to measure.
+  size_t last;        // The end of the chunk being measured.
+  mem::vector<bool> newpen;
+};
+
+void texbounds(texlabels& labels, iopipestream& tex, const string& texengine,
+               bool Inline)
+{
+  const char **abort=texabort(texengine);
+  bool Latex=latex(texengine);
+  
+  // The labels are shared in consecutive parts among tex and the pipes of
+  // the pool, which work on their chunks at the same time, unless one of
+  // them may change the state of TeX that the labels after it see.
+  size_t n=labels.size();
+  size_t workers=texworkers((n+texchunk-1)/texchunk);
+  for(size_t i=0; i < n && workers > 0; ++i)
+    if(labelcache::stateful(labels[i].s))
+      workers=0;
+  texpool &pool=processData().TeXpool;
+  size_t pipes=workers+1;
+  mem::vector<texshard> shards(pipes);
+  for(size_t j=0; j < pipes; ++j) {
+    texshard& s=shards[j];
+    s.tex=j == 0 ? &tex : pool[j-1];
+    s.lastpen=j == 0 ? &drawElement::lastpen : &pool[j-1]->lastpen;
+    s.next=j*n/pipes;
+    s.end=(j+1)*n/pipes;
+  }
+  
+  for(;;) {
+    bool done=true;
+    for(size_t j=0; j < pipes; ++j) {
+      texshard& s=shards[j];
+      if(s.next < s.end) {
+        s.last=texsend(*s.tex,*s.lastpen,labels,s.next,
+                       std::min(s.next+texchunk,s.end),s.newpen,Latex);
+        done=false;
+      }
+    }
+    if(done) break;
+    
+    // Errors are reported in the order of the labels, once every pipe has
+    // replied.
+    string errors;
+    for(size_t j=0; j < pipes; ++j) {
+      texshard& s=shards[j];
+      if(s.next < s.end) {
+        errors += texdims(*s.tex,labels,s.next,s.last,s.newpen,abort,Inline);
+        s.next=s.last;
+      }
+    }
+    if(!errors.empty())
+      reportError(errors);
+  }
+}
+
 inline double urand()
 {                         
   static const double factor=2.0/RAND_MAX;
@@ -126,15 +351,74 @@ void setpen(iopipestream& tex, const string& texengine, const pen& pentype)
 void drawLabel::getbounds(iopipestream& tex, const string& texengine)
 {
   if(havebounds) return;
+  getbounds(labelvector(1,this),tex,texengine);
+}
+
+void drawLabel::measure(iopipestream& tex, const string& texengine,
+                        bool failed)
+{
   havebounds=true;
   
   const char **abort=texabort(texengine);
   setpen(tex,texengine,pentype);
   
   bool nullsize=size.empty();
-  if(!texbounds(width,height,depth,tex,label,abort,nullsize,
-                getSetting<bool>("inlinetex")) && !nullsize)
+  if(failed) {
+    if(nullsize)
+      sizewarning(label);
+  } else if(texbounds(width,height,depth,tex,label,abort,nullsize,
+                      getSetting<bool>("inlinetex"))) {
+    labelcache::store(label,pentype,width,height,depth);
+    setalign();
+    return;
+  }
+  if(!nullsize)
     texbounds(width,height,depth,tex,size,abort,false);
+  setalign();
+}
+
+void drawLabel::getbounds(const labelvector& labels, iopipestream& tex,
+                          const string& texengine)
+{
+  if(texengine == "none") return;
+  
+  // The TeX pipe is shared by all threads.
+  parallel::serial();
+  
+  labelvector pending;
+  texlabels batch;
+  for(labelvector::const_iterator p=labels.begin(); p != labels.end(); ++p) {
+    drawLabel *L=*p;
+    if(L->havebounds) continue;
+    if(labelcache::lookup(L->label,L->pentype,L->width,L->height,L->depth)) {
+      L->havebounds=true;
+      L->setalign();
+    } else {
+      pending.push_back(L);
+      batch.push_back(texlabel(L->label,L->pentype));
+    }
+  }
+  if(batch.empty()) return;
+  
+  texensure();
+  texbounds(batch,tex,texengine,getSetting<bool>("inlinetex"));
+  
+  for(size_t i=0; i < batch.size(); ++i) {
+    drawLabel *L=pending[i];
+    const texlabel& l=batch[i];
+    if(l.measured) {
+      L->havebounds=true;
+      L->width=l.width;
+      L->height=l.height;
+      L->depth=l.depth;
+      labelcache::store(L->label,L->pentype,L->width,L->height,L->depth);
+      L->setalign();
+    } else L->measure(tex,texengine,l.failed);
+  }
+}
+
+void drawLabel::setalign()
+{
   enabled=true;
     
   Align=inverse(T)*align;
@@ -15,6 +15,9 @@
 
 namespace camp {
   
+class drawLabel;
+typedef mem::vector<drawLabel *> labelvector;
+
 class drawLabel : public virtual drawElement {
 protected:
   string label,size;
@@ -31,6 +34,14 @@ protected:
   bbox Box;
   bool enabled;
   
+  // Measures the label by itself, or, if TeX reported an error in setting
+  // it in a batch, only the string giving its size.
+  void measure(iopipestream& tex, const string& texengine,
+               bool failed=false);
+  
+  // Aligns the label, once its size is known.
+  void setalign();
+  
 public:
   drawLabel(string label, string size, transform T, pair position,
             pair align, pen pentype)
@@ -42,6 +53,11 @@ public:
 
   void getbounds(iopipestream& tex, const string& texengine);
   
+  // Finds the bounds of the labels not yet measured, sending those that
+  // are not in the label cache to TeX together.
+  static void getbounds(const labelvector& labels, iopipestream& tex,
+                        const string& texengine);
+
   void checkbounds();
     
   void bounds(bbox& b, iopipestream&, boxvector&, bboxlist&);
@@ -79,11 +95,35 @@ public:
   drawElement *transformed(const transform& t);
 };
 
+// A label measured by TeX as one of a batch.
+struct texlabel {
+  string s;
+  pen p;
+  double width,height,depth;
+  bool measured;
+  bool failed; // Whether TeX reported an error in setting it.
+  
+  texlabel(const string& s, const pen& p)
+    : s(s), p(p), width(0.0), height(0.0), depth(0.0), measured(false),
+      failed(false) {}
+};
+
+typedef mem::vector<texlabel> texlabels;
+
 void setpen(iopipestream& tex, const string& texengine, const pen& pentype);
 bool texbounds(double& width, double& height, double& depth,
                iopipestream& tex, string& s, const char **abort,
                bool warn, bool Inline=false);
 
+// Measures a batch of labels, sending them to TeX a chunk at a time, and
+// sharing large batches with the pipes of the pool (see texworkers).  A
+// label that TeX reports an error for is left unmeasured and marked as
+// failed; it is not sent again, so that what it does to TeX is done once.
+// Labels left unmeasured by a pipe that died are not marked.  The errors are
+// then reported together, except those in setting a label if Inline.
+void texbounds(texlabels& labels, iopipestream& tex, const string& texengine,
+               bool Inline=false);
+
 }
 
 #endif
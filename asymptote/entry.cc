@@ -99,7 +99,7 @@ bool tenv::add(symbol dest,
                names_t::value_type &x, varEntry *qualifier, coder &c)
 {
   if (!x.second.empty()) {
-    tyEntry *ent=x.second.front();
+    tyEntry *ent=x.second.back();
     if (ent->checkPerm(READ, c)) {
       enter(dest, qualifyTyEntry(qualifier, ent));
       return true;
@@ -589,6 +589,7 @@ void venv::namevalue::replaceType(ty *new_t, ty *old_t) {
     for (ty_iterator i = t->begin(); i != t->end(); ++i) {
       if (equivalent(old_t, *i)) {
         *i = new_t;
+        ((overloaded *)t)->changed();
         return;
       }
     }
@@ -632,6 +633,7 @@ void venv::namevalue::popType()
     // We are relying on the fact that this was the last type added to t, and
     // that type are added by pushing them on the end of the vector.
     set.pop_back();
+    ((overloaded *)t)->changed();
 
     if (set.size() == 1)
       t = set.front();
@@ -651,6 +653,9 @@ void venv::namevalue::popType()
 void venv::remove(const addition& a) {
   CHECKNAME(a.name);
 
+  if (a.name.special())
+    ++special_changes;
+
   if (a.shadowed) {
     varEntry *popEnt = core.store(a.name, a.shadowed);
 
@@ -690,6 +695,7 @@ void venv::endScope() {
     // clear the hash tables to return to that state.
     core.clear();
     names.clear();
+    ++special_changes;
 
     assert(empty_scopes > 0);
     --empty_scopes;
@@ -724,6 +730,9 @@ void venv::enter(symbol name, varEntry *v)
 {
   CHECKNAME(name);
 
+  if (name.special())
+    ++special_changes;
+
   // Store the new variable.  If it shadows an older variable, that varEntry
   // will be returned.
   varEntry *shadowed = core.store(name, v);
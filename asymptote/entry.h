@@ -407,17 +407,6 @@ class venv {
   scopestack scopesizes;
 
 
-  struct namehash {
-    size_t operator()(const symbol name) const {
-      return name.hash();
-    }
-  };
-  struct nameeq {
-    bool operator()(const symbol s, const symbol t) const {
-      return s==t;
-    }
-  };
-
   struct namevalue {
     size_t maxFormals;
     ty *t;
@@ -442,7 +431,8 @@ class venv {
 #ifdef NOHASH
   typedef mem::map<symbol CONST, namevalue> namemap;
 #else
-  typedef mem::unordered_map<symbol, namevalue, namehash, nameeq> namemap;
+  typedef mem::unordered_map<symbol, namevalue, sym::symbolHash,
+                             sym::symbolEq> namemap;
 #endif
   namemap names;
 
@@ -465,9 +455,13 @@ class venv {
 
   // The number of scopes begun (but not yet ended) when the venv was empty.
   size_t empty_scopes;
+
+  // Counts the changes to the casts and other special operators, on which
+  // the resolution of calls depends.
+  size_t special_changes;
 public:
   venv() :
-    core(1 << 2), empty_scopes(0) {}
+    core(1 << 2), empty_scopes(0), special_changes(0) {}
 
   // Most file level modules automatically import plain, so allocate hashtables
   // big enough to hold it in advance.
@@ -477,7 +471,7 @@ public:
 #ifndef NOHASH
     names(fileNamesSize),
 #endif
-    empty_scopes(0) {}
+    empty_scopes(0), special_changes(0) {}
 
   // Add a new variable definition.
   void enter(symbol name, varEntry *v);
@@ -516,6 +510,11 @@ public:
   // particular name.
   ty *getType(symbol name);
 
+  // Changes whenever a cast is added or removed.
+  size_t specialChanges() const {
+    return special_changes;
+  }
+
   void beginScope();
   void endScope();
   
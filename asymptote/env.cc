@@ -197,7 +197,7 @@ void protoenv::addFunctionOps(function *f)
 }
 
 env::env(genv &ge)
-  : protoenv(venv::file_env_tag()), ge(ge)
+  : protoenv(venv::file_env_tag()), ge(ge), resolutions(0)
 {
   // NOTE: May want to make this initial environment into a "builtin" module,
   // and then import the builtin module.
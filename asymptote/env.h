@@ -26,6 +26,7 @@ using types::function;
 using types::record;
 
 class genv;
+class resolutionCache;
 
 // Keeps track of the name bindings of variables and types.  This is used for
 // the fields of a record, whereas the derived class env is used for unqualified
@@ -174,6 +175,10 @@ class env : public protoenv {
   // The global environment - keeps track of modules.
   genv &ge;
 public:
+  // The resolutions of calls to overloaded functions, kept by multimatch in
+  // application.cc.
+  resolutionCache *resolutions;
+
   // Start an environment for a file-level module.
   env(genv &ge);
 
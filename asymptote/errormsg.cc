@@ -9,6 +9,7 @@
 #include <cstdlib>
 
 #include "errormsg.h"
+#include "parallel.h"
 
 errorstream em;
 
@@ -35,6 +36,7 @@ void errorstream::clear()
 
 void errorstream::message(position pos, const string& s)
 {
+  parallel::serial();
   if (floating) out << endl;
   out << pos << s;
   floating = true;
@@ -22,6 +22,7 @@
 #include "stm.h"
 #include "inst.h"
 #include "opsymbols.h"
+#include "fold.h"
 
 namespace absyntax {
 
@@ -181,6 +182,13 @@ void nameExp::prettyprint(ostream &out, Int indent)
   value->prettyprint(out, indent+1);
 }
 
+varEntry *nameExp::getCalleeOfType(coenv &e, function *t)
+{
+  // A simple name is looked up by type when it is called.
+  return dynamic_cast<simpleName *>(value) ?
+    e.e.lookupVarByType(getName(), t) : 0;
+}
+
 
 void fieldExp::pseudoName::prettyprint(ostream &out, Int indent)
 {
@@ -967,11 +975,63 @@ types::ty *callExp::transPerfectMatch(coenv &e) {
   return ct ? ct : dynamic_cast<function *>(ve->getType())->getResult();
 }
 
+bool callExp::foldConstant(coenv &e, item &value)
+{
+  // Only calls of a builtin whose arguments match its signature exactly, with
+  // no casts, defaults or reordering, are folded.  The call was resolved when
+  // its type was computed.
+  varEntry *ve = cachedVarEntry;
+  if (ve == 0 && cachedApp && cachedApp->exact() &&
+      cachedApp->getType()->getSignature()->formals.size() == args->size()) {
+    for (size_t i = 0; i < args->size(); ++i)
+      if ((*args)[i].name)
+        return false;
+    ve = callee->getCalleeOfType(e, cachedApp->getType());
+  }
+  if (ve == 0 || args->rest.val)
+    return false;
+
+  bltinAccess *a = dynamic_cast<bltinAccess *>(ve->getLocation());
+  if (a == 0)
+    return false;
+
+  const size_t MAX_OPERANDS = 2;
+  item operands[MAX_OPERANDS];
+  size_t n = args->size();
+  if (n > MAX_OPERANDS)
+    return false;
+  for (size_t i = 0; i < n; ++i)
+    if (!(*args)[i].val->foldConstant(e, operands[i]))
+      return false;
+
+  return fold(a->getFunction(), operands, n, value);
+}
+
+types::ty *callExp::transFolded(coenv &e) {
+  item value;
+  if (!foldConstant(e, value))
+    return 0;
+
+  types::ty *t = getType(e);
+  cachedVarEntry = 0;
+  cachedApp = 0;
+
+  if (t->kind == ty_Int)
+    e.c.encode(inst::intpush, vm::get<Int>(value));
+  else
+    e.c.encode(inst::constpush, value);
+  return t;
+}
+
 types::ty *callExp::trans(coenv &e)
 {
   if (cachedVarEntry == 0 && cachedApp == 0)
     cacheAppOrVarEntry(e, false);
 
+  if (settings::peephole)
+    if (types::ty *t = transFolded(e))
+      return t;
+
   if (cachedVarEntry)
     return transPerfectMatch(e);
 
@@ -1033,7 +1093,7 @@ types::ty *pairExp::trans(coenv &e)
   x->transToType(e, types::primReal());
   y->transToType(e, types::primReal());
 
-  e.c.encode(inst::builtin, run::realRealToPair);
+  e.c.encodeBuiltin(run::realRealToPair);
 
   return types::primPair();
 }
@@ -1053,7 +1113,7 @@ types::ty *tripleExp::trans(coenv &e)
   y->transToType(e, types::primReal());
   z->transToType(e, types::primReal());
 
-  e.c.encode(inst::builtin, run::realRealRealToTriple);
+  e.c.encodeBuiltin(run::realRealRealToTriple);
 
   return types::primTriple();
 }
@@ -127,6 +127,13 @@ public:
     return 0;
   }
 
+  // Once a call of the expression has been resolved to the function type t,
+  // returns the varEntry of the function that will be called, or 0 if this
+  // cannot be determined without translating the expression.
+  virtual trans::varEntry *getCalleeOfType(coenv &, types::function *) {
+    return 0;
+  }
+
   // Same result as getType, but caches the result so that subsequent
   // calls are faster.  For this to work correctly, the expression should
   // only be used in one place, so the environment doesn't change between
@@ -182,6 +189,13 @@ public:
   // sufficient for most expressions.
   virtual exp *evaluate(coenv &e, types::ty *target);
 
+  // If the value of the expression is a constant known at compile time, such
+  // as a literal or an arithmetic expression of literals, store it in value
+  // and return true.  Nothing is translated.
+  virtual bool foldConstant(coenv &, vm::item &) {
+    return false;
+  }
+
   // NOTE: could add a "side-effects" method which says if the expression has
   // side-effects.  This might allow some small optimizations in translating.
 };
@@ -284,6 +298,8 @@ public:
     return value->getCallee(e, sig);
   }
 
+  trans::varEntry *getCalleeOfType(coenv &e, types::function *t);
+
   void transWrite(coenv &e, types::ty *target, exp *newValue) {
     newValue->transToType(e, target);
     this->value->varTrans(trans::WRITE, e, target);
@@ -513,6 +529,11 @@ public:
 
   types::ty *trans(coenv &e);
   types::ty *getType(coenv &) { return types::primInt(); }
+
+  bool foldConstant(coenv &, vm::item &v) {
+    v=value;
+    return true;
+  }
 };
 
 class realExp : public literalExp {
@@ -527,6 +548,11 @@ public:
 
   types::ty *trans(coenv &e);
   types::ty *getType(coenv &) { return types::primReal(); }
+
+  bool foldConstant(coenv &, vm::item &v) {
+    v=value;
+    return true;
+  }
 };
 
 
@@ -556,6 +582,11 @@ public:
 
   types::ty *trans(coenv &e);
   types::ty *getType(coenv &) { return types::primBoolean(); }
+
+  bool foldConstant(coenv &, vm::item &v) {
+    v=value;
+    return true;
+  }
 };
 
 class cycleExp : public literalExp {
@@ -766,6 +797,9 @@ private:
   types::ty *cacheAppOrVarEntry(coenv &e, bool tacit);
 
   types::ty *transPerfectMatch(coenv &e);
+
+  // Pushes the value of the call if it can be computed at compile time.
+  types::ty *transFolded(coenv &e);
 public:
   callExp(position pos, exp *callee, arglist *args)
     : exp(pos), callee(callee), args(args),
@@ -804,6 +838,9 @@ public:
   // Returns true if the function call resolves uniquely without error.  Used
   // in implementing the special == and != operators for functions.
   virtual bool resolved(coenv &e);
+
+  // A call of a builtin operator on constants is itself constant.
+  bool foldConstant(coenv &e, vm::item &value);
 };
 
 
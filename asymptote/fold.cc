@@ -0,0 +1,115 @@
+/*****
+ * fold.cc
+ *
+ * Constant folding of the operators on primitive types.
+ *****/
+
+#include "fold.h"
+#include "mathop.h"
+
+namespace trans {
+
+using vm::item;
+using vm::get;
+using namespace run;
+
+namespace {
+
+typedef bool (*folder)(const item *args, item &value);
+
+template<class T, template <class S> class op>
+bool binary(const item *args, item &value)
+{
+  value=op<T>()(get<T>(args[0]),get<T>(args[1]));
+  return true;
+}
+
+// Integer arithmetic that would overflow is left to be reported at runtime,
+// as the expression may never be evaluated.
+template<template <class S> class op, bool (*overflows)(Int,Int)>
+bool integer(const item *args, item &value)
+{
+  Int x=get<Int>(args[0]), y=get<Int>(args[1]);
+  if(overflows(x,y))
+    return false;
+  value=op<Int>()(x,y);
+  return true;
+}
+
+template<class T>
+bool quotient(const item *args, item &value)
+{
+  if(get<T>(args[1]) == 0)
+    return false;
+  return binary<T,divide>(args,value);
+}
+
+template<class T>
+bool negate(const item *args, item &value)
+{
+  value=-get<T>(args[0]);
+  return true;
+}
+
+template<>
+bool negate<Int>(const item *args, item &value)
+{
+  Int x=get<Int>(args[0]);
+  if(x < -Int_MAX)
+    return false;
+  value=-x;
+  return true;
+}
+
+struct entry {
+  vm::bltin f;
+  size_t n;
+  folder fold;
+};
+
+#define BINARY(T,op) {binaryOp<T,op>,2,binary<T,op>}
+
+const entry table[]={
+  {binaryOp<Int,plus>,2,integer<plus,sumOverflows>},
+  {binaryOp<Int,minus>,2,integer<minus,differenceOverflows>},
+  {binaryOp<Int,times>,2,integer<times,productOverflows>},
+  {binaryOp<Int,divide>,2,quotient<Int>},
+  {Negate<Int>,1,negate<Int>},
+  BINARY(Int,equals), BINARY(Int,notequals),
+  BINARY(Int,less), BINARY(Int,lessequals),
+  BINARY(Int,greater), BINARY(Int,greaterequals),
+  BINARY(Int,min), BINARY(Int,max),
+
+  BINARY(double,plus), BINARY(double,minus), BINARY(double,times),
+  {binaryOp<double,divide>,2,quotient<double>},
+  {Negate<double>,1,negate<double>},
+  BINARY(double,equals), BINARY(double,notequals),
+  BINARY(double,less), BINARY(double,lessequals),
+  BINARY(double,greater), BINARY(double,greaterequals),
+  BINARY(double,min), BINARY(double,max),
+
+  BINARY(bool,And), BINARY(bool,Or), BINARY(bool,Xor),
+  BINARY(bool,equals), BINARY(bool,notequals)
+};
+
+#undef BINARY
+
+const size_t tableSize=sizeof(table)/sizeof(entry);
+
+} // private
+
+bool fold(vm::bltin f, const item *args, size_t n, item &value)
+{
+  // Integers can collide with the values marking uninitialized items; that
+  // is left to be reported at runtime too.
+  for(size_t i=0; i < n; ++i)
+    if(args[i].empty())
+      return false;
+
+  for(size_t i=0; i < tableSize; ++i)
+    if(table[i].f == f)
+      return table[i].n == n && table[i].fold(args,value) && !value.empty();
+  return false;
+}
+
+} // namespace trans
@@ -0,0 +1,23 @@
+/*****
+ * fold.h
+ *
+ * Constant folding of the operators on primitive types.
+ *****/
+
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "item.h"
+#include "vm.h"
+
+namespace trans {
+
+// If f is one of the builtin operators on int, real or bool and applying it
+// to the n arguments args cannot raise an error, store the result in value
+// and return true.  Operations that would fail are not folded, so that the
+// error is still reported when the code is run.
+bool fold(vm::bltin f, const vm::item *args, size_t n, vm::item &value);
+
+} // namespace trans
+
+#endif // FOLD_H
@@ -13,6 +13,7 @@
 #include <cassert>
 
 #include "access.h"
+#include "program.h"
 
 namespace trans {
 
@@ -27,7 +28,23 @@ class frame : public gc {
   // global variables is an "indirect" frame.  It holds one variable, which is
   // a link to another frame.  When the subframe is too small, a larger
   // runtime array is allocated, and the link is changed.
-  enum {DIRECT_FRAME, INDIRECT_FRAME} style;
+  //
+  // The variables of a function are kept on the stack of the virtual machine
+  // in a STACK_FRAME.  Only those variables that escape, by being used from a
+  // nested function, record, or loop frame, are moved to a closure record.
+  // The record holds the link to the parent frame followed by the escaping
+  // variables, and is only allocated when the function first needs it.
+  enum {DIRECT_FRAME, INDIRECT_FRAME, STACK_FRAME} style;
+
+  // For a STACK_FRAME, the index of each variable in the closure record, or
+  // zero (or nothing) if the variable has not escaped.
+  mem::vector<Int> captured;
+  Int numCaptured;
+
+  // The instructions that use a variable on the stack, so that they can be
+  // redirected to the closure record if the variable escapes later on.
+  typedef std::pair<Int,vm::program::label> use_t;
+  mem::vector<use_t> uses;
 
 #ifdef DEBUG_FRAME
   string name;
@@ -35,16 +52,16 @@ class frame : public gc {
 
   frame(string name)
     : parent(new frame("<subframe of " + name + ">", 0, 0)),
-      numFormals(0), numLocals(1), style(INDIRECT_FRAME)
+      numFormals(0), numLocals(1), style(INDIRECT_FRAME), numCaptured(0)
 #ifdef DEBUG_FRAME
       , name(name)
 #endif
   {}
 
 public:
-  frame(string name, frame *parent, size_t numFormals)
+  frame(string name, frame *parent, size_t numFormals, bool onStack=false)
     : parent(parent), numFormals(numFormals), numLocals(0),
-      style(DIRECT_FRAME)
+      style(onStack ? STACK_FRAME : DIRECT_FRAME), numCaptured(0)
 #ifdef DEBUG_FRAME
       , name(name)
 #endif
@@ -63,8 +80,56 @@ public:
     return numFormals;
   }
 
+  // Tests if the variables of the frame are kept on the stack.
+  bool onStack() {
+    return style == STACK_FRAME;
+  }
+
+  // Where the link to the parent frame is found when the frame is reached
+  // through a closure.
+  Int linkIndex() {
+    return onStack() ? 0 : parentIndex();
+  }
+
+  // The number of items in the closure record of a STACK_FRAME.
+  Int closureSize() {
+    return 1+numCaptured;
+  }
+
+  // Tests if a variable of a STACK_FRAME has been moved to the closure record.
+  bool escaped(Int index) {
+    return (size_t) index < captured.size() && captured[index] != 0;
+  }
+
+  // Records an instruction that reads or writes a variable directly.
+  void use(Int index, vm::program::label l) {
+    if (style == STACK_FRAME)
+      uses.push_back(use_t(index,l));
+  }
+
+  // Where a variable is found when the frame is reached through a closure.
+  // A variable of a STACK_FRAME escapes by this, and the instructions recorded
+  // so far are redirected to its place in the closure record.
+  Int closureIndex(Int index) {
+    if (style != STACK_FRAME)
+      return index;
+    if (!escaped(index)) {
+      if ((size_t) index >= captured.size())
+        captured.resize(index+1);
+      captured[index] = ++numCaptured;
+      for (size_t i = 0; i < uses.size(); ++i)
+        if (uses[i].first == index) {
+          vm::inst& in = *uses[i].second;
+          in.op = in.op == vm::inst::varsave ? vm::inst::closuresave :
+                                               vm::inst::closurepush;
+          in.ref = captured[index];
+        }
+    }
+    return captured[index];
+  }
+
   Int size() {
-    if (style == DIRECT_FRAME)
+    if (style != INDIRECT_FRAME)
       return (Int) (1+numFormals+numLocals);
     else
       return parent->size();
@@ -72,12 +137,12 @@ public:
 
   access *accessFormal(size_t index) {
     assert(index < numFormals);
-    assert(style == DIRECT_FRAME);
+    assert(style != INDIRECT_FRAME);
     return new localAccess((Int) (index), this);
   }
 
   access *allocLocal() {
-    if (style == DIRECT_FRAME)
+    if (style != INDIRECT_FRAME)
       return new localAccess((Int) (1 + numFormals + numLocals++), this);
     else
       return parent->allocLocal();
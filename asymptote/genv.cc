@@ -28,6 +28,8 @@
 #include "locate.h"
 #include "interact.h"
 #include "builtin.h"
+#include "heap.h"
+#include "timings.h"
 
 using namespace types;
 using settings::getSetting;
@@ -72,6 +74,8 @@ record *genv::loadModule(symbol id, string filename) {
   }
 #endif
 
+  mem::heapStats before;
+
   // Get the abstract syntax tree.
   absyntax::file *ast = parser::parseFile(filename,"Loading");
 
@@ -79,9 +83,17 @@ record *genv::loadModule(symbol id, string filename) {
 
   em.sync();
 
-  record *r=ast->transAsFile(*this, id);
+  record *r;
+  {
+    timings::phase t(timings::TRANSLATE);
+    r=ast->transAsFile(*this, id);
+  }
   
   inTranslation.remove(filename);
+  moduleFiles.push_back(settings::locateFile(filename));
+
+  if(getSetting<bool>("heapstats"))
+    mem::reportHeap("after loading "+filename,before);
 
   return r;
 }
@@ -38,6 +38,9 @@ class genv : public gc {
   // recursion in loading modules.
   mem::list<string> inTranslation;
 
+  // The files from which modules were translated.
+  mem::list<string> moduleFiles;
+
   // Checks for recursion in loading, reporting an error and throwing an
   // exception if it occurs.
   void checkRecursion(string filename);
@@ -54,6 +57,10 @@ public:
   // Uses the filename->record map to build a filename->initializer map to be
   // used at runtime.
   vm::stack::importInitMap *getInitMap();
+
+  const mem::list<string>& files() {
+    return moduleFiles;
+  }
 };
 
 } // namespace trans
@@ -0,0 +1,98 @@
+/*****
+ * heap.cc
+ *
+ * Arenas of collected memory, and statistics of the heap.
+ *****/
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <iomanip>
+
+#include "heap.h"
+
+namespace mem {
+
+namespace {
+
+const size_t BLOCKSIZE=16384;
+
+// Objects of unknown type are aligned as strictly as a long double.
+const size_t ALIGNMENT=16;
+
+void *allocateBlock(size_t n)
+{
+#ifdef USEGC
+  // Objects are kept alive by pointers into the middle of the block, so it
+  // cannot be allocated with GC_malloc_ignore_off_page.
+#ifdef GC_DEBUG
+  void *mem=GC_debug_malloc(n,GC_EXTRAS);
+#else
+  void *mem=GC_malloc(n);
+#endif
+  if(!mem) throw std::bad_alloc();
+  return mem;
+#else
+  return ::operator new(n);
+#endif
+}
+
+} // private
+
+void *arena::allocate(size_t n)
+{
+  n=(n+ALIGNMENT-1) & ~(ALIGNMENT-1);
+  if(n > BLOCKSIZE/4)
+    return allocateBlock(n);
+  if(next+n > end) {
+    next=(char *) allocateBlock(BLOCKSIZE);
+    end=next+BLOCKSIZE;
+  }
+  void *p=next;
+  next += n;
+  return p;
+}
+
+heapStats::heapStats()
+{
+#ifdef USEGC
+  heap=GC_get_heap_size();
+  free=GC_get_free_bytes();
+  allocated=GC_get_total_bytes();
+  collections=GC_gc_no;
+#else
+  heap=free=allocated=collections=0;
+#endif
+  struct rusage usage;
+  rss=getrusage(RUSAGE_SELF,&usage) == 0 ? 1024*(size_t) usage.ru_maxrss : 0;
+}
+
+namespace {
+
+void megabytes(ostream& out, const char *name, size_t now, size_t before)
+{
+  out << " " << name << " " << now/1048576.0 << "MB";
+  if(now != before)
+    out << " (" << (now > before ? "+" : "-")
+        << (now > before ? now-before : before-now)/1048576.0 << "MB)";
+}
+
+} // private
+
+void reportHeap(const string& stage, const heapStats& before)
+{
+  heapStats now;
+  ostringstream buf;
+  buf << std::fixed << std::setprecision(1) << "memory " << stage << ":";
+#ifdef USEGC
+  buf << " collections " << now.collections;
+  if(now.collections != before.collections)
+    buf << " (+" << now.collections-before.collections << ")";
+  megabytes(buf,"heap",now.heap,before.heap);
+  megabytes(buf,"free",now.free,before.free);
+  megabytes(buf,"allocated",now.allocated,before.allocated);
+#endif
+  megabytes(buf,"max RSS",now.rss,before.rss);
+  cerr << buf.str() << endl;
+}
+
+} // namespace mem
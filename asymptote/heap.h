@@ -0,0 +1,53 @@
+/*****
+ * heap.h
+ *
+ * Arenas of collected memory, and statistics of the heap.
+ *****/
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "common.h"
+
+namespace mem {
+
+// Hands out the space for many small objects from a few large blocks of
+// collected memory.  Objects are never freed one at a time: a block is
+// reclaimed by the collector as a whole once nothing points into it, so an
+// arena suits objects that are created together and die together, such as
+// the syntax tree of a file.  Objects allocated from an arena are not
+// finalized.
+class arena {
+  char *next;
+  char *end;
+public:
+  arena() : next(0), end(0) {}
+
+  void *allocate(size_t n);
+
+  // Starts a new block for the objects allocated next, so that they do not
+  // keep the objects allocated so far alive, or the other way round.
+  void release() {
+    next=end=0;
+  }
+};
+
+// A snapshot of the use of memory, in bytes.  Without the collector, only
+// the resident set size is known.
+struct heapStats {
+  size_t heap;         // Size of the collected heap.
+  size_t free;         // Free bytes in the collected heap.
+  size_t allocated;    // Bytes allocated since asy started.
+  size_t collections;  // Collections since asy started.
+  size_t rss;          // Largest resident set size so far.
+
+  heapStats();
+};
+
+// Reports the use of memory now, and its change since before, for the
+// given stage of the run.
+void reportHeap(const string& stage, const heapStats& before);
+
+} // namespace mem
+
+#endif
@@ -33,26 +33,31 @@ struct lambda : public gc {
   // The total number of items that will be stored in the closure of this
   // function.  Includes a link to the higher closure, the parameters, and the
   // local variables.
-  // NOTE: In order to help garbage collection, this could be modified to
-  // have one array store escaping items, and another to store non-
-  // escaping items.
   size_t framesize;
 
+  // For a function that keeps its variables on the stack, the number of items
+  // in the closure record that holds its escaping variables, after the link
+  // to the higher closure.  Zero if all variables are stored in the closure.
+  size_t closuresize;
+
+  // The positions in the frame of the escaping variables, in the order of
+  // their places in the closure record.  They stay on the stack until the
+  // function first needs the record, and are then copied to it.
+  mem::vector<size_t> escaping;
+
   // States whether any of the variables escape the function, in which case a
   // closure needs to be allocated when the function is called.  It is
   // initially set to "maybe" and it is computed the first time the function
   // is called.
   enum { NEEDS_CLOSURE, DOESNT_NEED_CLOSURE, MAYBE_NEEDS_CLOSURE} closureReq;
 
-#ifdef DEBUG_FRAME
+  // The name of the function, for profiles and debugging output.
   string name;
 
   lambda()
-    : closureReq(MAYBE_NEEDS_CLOSURE), name("<unnamed>") {}
+    : closuresize(0), closureReq(MAYBE_NEEDS_CLOSURE), name("<unnamed>") {}
+#ifdef DEBUG_FRAME
   virtual ~lambda() {}
-#else
-  lambda()
-    : closureReq(MAYBE_NEEDS_CLOSURE) {}
 #endif
 };
 
@@ -72,6 +77,20 @@ template<typename T>
 inline T get(const inst& it)
 { return get<T>(it.ref); }
 
+// A call of a native builtin whose arguments are all variables of the frame
+// or constants, which the peephole optimizer forms from the instructions
+// pushing the arguments and the call, so that the arguments are read
+// straight from the frame.
+struct nativeCall : public gc {
+  enum { MAXARGS = 6 };
+
+  const nativeEntry *entry;
+
+  // The variable holding each argument, or -1 for a constant.
+  Int var[MAXARGS];
+  item value[MAXARGS];
+};
+
 } // namespace vm
 
 #endif
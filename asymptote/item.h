@@ -41,7 +41,29 @@ inline Int valueFromBool(bool b) {
   return b ? BoolTruthValue : BoolFalseValue;
 }
 #endif
-  
+
+// Types whose items hold no pointers into the heap.  The storage of arrays of
+// these types is not scanned by the collector.
+template<typename T>
+struct pointerFree { static const bool value=false; };
+template<>
+struct pointerFree<Int> { static const bool value=true; };
+template<>
+struct pointerFree<double> { static const bool value=true; };
+template<>
+struct pointerFree<bool> { static const bool value=true; };
+
+// Types whose items, in COMPACT builds, are the values themselves, so that the
+// items of an array of them are packed values.
+template<typename T>
+struct packable { static const bool value=false; };
+#if COMPACT
+template<>
+struct packable<Int> { static const bool value=true; };
+template<>
+struct packable<double> { static const bool value=true; };
+#endif
+
 extern const item Default;
 
 class item : public gc {
@@ -0,0 +1,450 @@
+/*****
+ * labelcache.cc
+ *
+ * Keeps the dimensions of labels measured by TeX, and the outlines of
+ * labels found by texpath and textpath, in files under the configuration
+ * directory.
+ *****/
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <cctype>
+
+#include "labelcache.h"
+#include "texfile.h"
+#include "parallel.h"
+#include "array.h"
+#include "path.h"
+
+using namespace settings;
+using vm::array;
+using vm::read;
+
+namespace camp {
+namespace labelcache {
+
+namespace {
+
+typedef mem::map<string,string> entries;
+
+// A file grown beyond this size is discarded when next read, and begun
+// again; beyond this number of files, the oldest files of a cache are
+// removed.
+const off_t maxbytes=4 << 20;
+const size_t maxfiles=32;
+
+// Commands by which TeX reads files, whose contents are not part of the key.
+const char *reads[]={"\\include","\\includegraphics","\\input",
+                     "\\InputIfFileExists","\\openin","\\read",NULL};
+
+// Commands that change the state of TeX, as seen by the labels set after
+// them, or whose effect depends on that state.
+const char *changes[]={"\\def","\\gdef","\\edef","\\xdef","\\global",
+                       "\\let","\\csname","\\newcommand","\\renewcommand",
+                       "\\providecommand","\\newcounter","\\setcounter",
+                       "\\addtocounter","\\stepcounter","\\refstepcounter",
+                       "\\advance","\\write",NULL};
+
+// Whether s uses one of the commands, by its whole name: \let is not found
+// in \left.
+bool contains(const string& s, const char **commands)
+{
+  for(const char **c=commands; *c; ++c) {
+    size_t n=strlen(*c);
+    for(size_t i=s.find(*c); i != string::npos; i=s.find(*c,i+n))
+      if(i+n == s.size() || !isalpha(s[i+n]))
+        return true;
+  }
+  return false;
+}
+
+// Whether the label s can be taken from the cache: it must not read files,
+// and TeX must not keep anything from setting it, as it would not if the
+// label were found in the cache.  The labels after one that changes the
+// state of TeX may depend on it, so they are not cached either, until the
+// next file processed.
+bool cacheable(const string& s)
+{
+  bool& changed=processData().TeXchanged;
+  if(changed) return false;
+  if(s.find('\\') == string::npos) return true;
+  if(contains(s,changes)) {
+    changed=true;
+    return false;
+  }
+  return !contains(s,reads);
+}
+
+string hex(unsigned long long h)
+{
+  ostringstream buf;
+  buf << std::hex << std::setw(16) << std::setfill('0') << h;
+  return buf.str();
+}
+
+void preamble(ostream& out, const mem::list<string>& preamble)
+{
+  for(mem::list<string>::const_iterator p=preamble.begin();
+      p != preamble.end(); ++p)
+    out << p->size() << " " << *p;
+  out << newl;
+}
+
+// The settings that the state of a fresh TeX pipe depends on, which are
+// cheap to compare.
+string texsignature()
+{
+  ostringstream buf;
+  buf << getSetting<string>("tex") << newl << texprogram() << newl
+      << outname() << newl;
+  preamble(buf,processData().TeXpreamble);
+  return buf.str();
+}
+
+// Packages and other files that TeX may load for the preamble from the
+// current directory, by their sizes and modification times.
+void localfiles(ostream& out)
+{
+  static const char *extensions[]={".sty",".cls",".clo",".cfg",".def",".fd",
+                                   NULL};
+  DIR *dir=opendir(".");
+  if(dir == NULL) return;
+  entries files;
+  dirent *p;
+  while((p=readdir(dir)) != NULL) {
+    string name=p->d_name;
+    for(const char **e=extensions; *e; ++e) {
+      size_t n=strlen(*e);
+      struct stat buf;
+      if(name.size() > n && name.compare(name.size()-n,n,*e) == 0 &&
+         stat(name.c_str(),&buf) == 0) {
+        ostringstream s;
+        s << buf.st_size << " " << buf.st_mtime;
+        files[name]=s.str();
+        break;
+      }
+    }
+  }
+  closedir(dir);
+  for(entries::iterator f=files.begin(); f != files.end(); ++f)
+    out << f->first << " " << f->second << newl;
+}
+
+// Everything that the state of a fresh TeX pipe depends on, or an empty
+// string if the preamble reads files of its own.
+string texcontext()
+{
+  mem::list<string>& TeXpreamble=processData().TeXpreamble;
+  for(mem::list<string>::iterator p=TeXpreamble.begin();
+      p != TeXpreamble.end(); ++p)
+    if(contains(*p,reads))
+      return "";
+  ostringstream buf;
+  buf << texsignature();
+  localfiles(buf);
+  texdocumentclass(buf,true);
+  texdefines(buf,processData().TeXpreamble,true);
+  // Labels may refer to the aux file of an earlier run.
+  std::ifstream aux(auxname(outname(),"aux").c_str());
+  if(aux)
+    buf << aux.rdbuf();
+  return buf.str();
+}
+
+// The outlines found by texpath depend also on the page set up by
+// texfile::miniprologue and on the programs that convert its output.
+string converters()
+{
+  ostringstream buf;
+  buf << getSetting<string>("gs") << newl;
+  if(!pdf(getSetting<string>("tex")))
+    buf << getSetting<string>("dvips") << newl
+        << getSetting<string>("dvipsOptions") << newl;
+  return buf.str();
+}
+
+string texpathsignature()
+{
+  return texsignature()+converters();
+}
+
+string texpathcontext()
+{
+  string context=texcontext();
+  return context.empty() ? context : context+converters();
+}
+
+string textpathsignature()
+{
+  ostringstream buf;
+  buf << getSetting<string>("textcommand") << newl
+      << getSetting<string>("textcommandOptions") << newl
+      << getSetting<string>("textprologue") << newl
+      << getSetting<string>("textepilogue") << newl
+      << getSetting<string>("textextension") << newl
+      << getSetting<string>("textoutformat") << newl
+      << getSetting<string>("gs") << newl;
+  return buf.str();
+}
+
+// A cache of one kind, kept in the directory of that name, which is not used
+// while the context is empty.  Each of its files holds the entries made
+// under one context, as a line giving the
+// lengths of the key and of the value, followed by the key, the value, and
+// a newline.  Entries are appended by single writes, which concurrent runs
+// cannot interleave; an entry cut short by a run that died while writing
+// ends the file.
+class cache {
+  const char *kind;
+  string (*signature)();
+  string (*context)();
+
+  // The signature that the file last used was chosen by.
+  bool chosen;
+  string last;
+  bool usable;
+
+  string filename;
+  entries values;
+
+  void load()
+  {
+    values.clear();
+    struct stat info;
+    if(stat(filename.c_str(),&info) != 0) {
+      prune();
+      return;
+    }
+    if(info.st_size > maxbytes) {
+      unlink(filename.c_str());
+      return;
+    }
+    std::ifstream fin(filename.c_str());
+    if(!fin) return;
+    ostringstream buf;
+    buf << fin.rdbuf();
+    const string data=buf.str();
+
+    size_t pos=0;
+    for(;;) {
+      size_t eol=data.find('\n',pos);
+      if(eol == string::npos) break;
+      istringstream header(data.substr(pos,eol-pos));
+      size_t n,m;
+      if(!(header >> n >> m)) break;
+      pos=eol+1;
+      if(n+m >= data.size()-pos || data[pos+n+m] != '\n') break;
+      values[data.substr(pos,n)]=data.substr(pos+n,m);
+      pos += n+m+1;
+    }
+  }
+
+  // Removes the oldest files of the cache, leaving room for one more.
+  void prune()
+  {
+    string dirname=initdir+"/"+kind;
+    DIR *dir=opendir(dirname.c_str());
+    if(dir == NULL) return;
+    mem::multimap<time_t,string> files;
+    dirent *p;
+    while((p=readdir(dir)) != NULL) {
+      string name=dirname+"/"+p->d_name;
+      struct stat buf;
+      if(p->d_name[0] != '.' && stat(name.c_str(),&buf) == 0)
+        files.insert(std::make_pair(buf.st_mtime,name));
+    }
+    closedir(dir);
+    for(mem::multimap<time_t,string>::iterator f=files.begin();
+        files.size() >= maxfiles; files.erase(f++))
+      unlink(f->second.c_str());
+  }
+
+  // Chooses the file for the current context, and reads it.
+  void choose()
+  {
+    string s=signature();
+    if(chosen && s == last)
+      return;
+
+    chosen=true;
+    last=s;
+
+    string context=this->context();
+    usable=!context.empty();
+    if(!usable) {
+      values.clear();
+      return;
+    }
+
+    // The FNV-1a hash of the context names the file.
+    string c=string(kind)+"\n"+VERSION+"\n"+context;
+    unsigned long long h=14695981039346656037ULL;
+    for(size_t i=0; i < c.size(); ++i)
+      h=(h ^ (unsigned char) c[i])*1099511628211ULL;
+    filename=initdir+"/"+kind+"/"+hex(h);
+    load();
+  }
+
+public:
+  cache(const char *kind, string (*signature)(), string (*context)())
+    : kind(kind), signature(signature), context(context), chosen(false),
+      usable(false) {}
+
+  bool lookup(const string& key, string& value)
+  {
+    choose();
+    if(!usable) return false;
+    entries::iterator e=values.find(key);
+    if(e == values.end())
+      return false;
+    value=e->second;
+    return true;
+  }
+
+  void store(const string& key, const string& value)
+  {
+    choose();
+    if(!usable) return;
+    values[key]=value;
+
+    ostringstream buf;
+    buf << key.size() << " " << value.size() << "\n" << key << value << "\n";
+    string entry=buf.str();
+
+    mkdir((initdir+"/"+kind).c_str(),0777);
+    int fd=open(filename.c_str(),O_WRONLY | O_APPEND | O_CREAT,0666);
+    if(fd < 0) return;
+    if(write(fd,entry.data(),entry.size()) != (ssize_t) entry.size() &&
+       verbose > 1)
+      cerr << "cannot write label cache " << filename << endl;
+    close(fd);
+  }
+};
+
+cache labels("labels",texsignature,texcontext);
+cache texpaths("texpaths",texpathsignature,texpathcontext);
+cache textpaths("textpaths",textpathsignature,textpathsignature);
+
+string key(const string& s, const pen& p)
+{
+  ostringstream buf;
+  string font=p.Font();
+  buf << std::setprecision(17) << p.size() << " " << p.Lineskip() << " "
+      << font.size() << " " << font << s;
+  return buf.str();
+}
+
+// Whether the cache is used for the label s.
+bool enabled(const string& s)
+{
+  if(!getSetting<bool>("labelcache"))
+    return false;
+  // The caches are shared by all threads.
+  parallel::serial();
+  return cacheable(s);
+}
+
+// An array of paths is written as the number of paths, followed by the
+// number of nodes of each path, whether it is cyclic, and its nodes.
+void writepair(ostream& out, const pair& z)
+{
+  out << " " << z.getx() << " " << z.gety();
+}
+
+string paths(const array *a)
+{
+  ostringstream buf;
+  buf << std::setprecision(17);
+  size_t n=a->size();
+  buf << n;
+  for(size_t i=0; i < n; ++i) {
+    path g=read<path>(a,i);
+    Int m=g.size();
+    buf << newl << m << " " << g.cyclic();
+    for(Int j=0; j < m; ++j) {
+      writepair(buf,g.precontrol(j));
+      writepair(buf,g.point(j));
+      writepair(buf,g.postcontrol(j));
+      buf << " " << g.straight(j);
+    }
+  }
+  return buf.str();
+}
+
+array *paths(const string& s)
+{
+  istringstream in(s);
+  size_t n;
+  if(!(in >> n)) return NULL;
+  array *a=new array(n);
+  for(size_t i=0; i < n; ++i) {
+    Int m;
+    bool cyclic;
+    if(!(in >> m >> cyclic) || m < 0) return NULL;
+    mem::vector<solvedKnot> nodes(m);
+    for(Int j=0; j < m; ++j) {
+      solvedKnot& k=nodes[j];
+      double x0,y0,x1,y1,x2,y2;
+      if(!(in >> x0 >> y0 >> x1 >> y1 >> x2 >> y2 >> k.straight))
+        return NULL;
+      k.pre=pair(x0,y0);
+      k.point=pair(x1,y1);
+      k.post=pair(x2,y2);
+    }
+    (*a)[i]=path(nodes,m,cyclic);
+  }
+  return a;
+}
+
+} // private
+
+bool lookup(const string& s, const pen& p, double& width, double& height,
+            double& depth)
+{
+  if(!enabled(s)) return false;
+  string value;
+  if(!labels.lookup(key(s,p),value))
+    return false;
+  istringstream in(value);
+  in >> width >> height >> depth;
+  return !in.fail();
+}
+
+void store(const string& s, const pen& p, double width, double height,
+           double depth)
+{
+  if(!enabled(s)) return;
+  ostringstream buf;
+  buf << std::setprecision(17) << width << " " << height << " " << depth;
+  labels.store(key(s,p),buf.str());
+}
+
+bool lookup(const string& s, const pen& p, bool tex, array*& outlines)
+{
+  if(!enabled(s)) return false;
+  string value;
+  if(!(tex ? texpaths : textpaths).lookup(key(s,p),value))
+    return false;
+  outlines=paths(value);
+  return outlines != NULL;
+}
+
+void store(const string& s, const pen& p, bool tex, const array *outlines)
+{
+  if(!enabled(s)) return;
+  (tex ? texpaths : textpaths).store(key(s,p),paths(outlines));
+}
+
+bool stateful(const string& s)
+{
+  return s.find('\\') != string::npos &&
+    (contains(s,changes) || contains(s,reads));
+}
+
+} // namespace labelcache
+} // namespace camp
@@ -0,0 +1,48 @@
+/*****
+ * labelcache.h
+ *
+ * Keeps the dimensions of labels measured by TeX, and the outlines of
+ * labels found by texpath and textpath, in files under the configuration
+ * directory, so that later runs setting the same labels under the same
+ * engine and preamble need not start TeX at all.
+ *****/
+
+#ifndef LABELCACHE_H
+#define LABELCACHE_H
+
+#include "common.h"
+#include "pen.h"
+
+namespace vm {
+class array;
+}
+
+namespace camp {
+namespace labelcache {
+
+// Finds the dimensions of the label s set in the font of pen p, as measured
+// earlier under the current TeX engine and preamble.
+bool lookup(const string& s, const pen& p, double& width, double& height,
+            double& depth);
+
+// Records the dimensions of a label just measured by TeX.
+void store(const string& s, const pen& p, double width, double height,
+           double depth);
+
+// Finds the outlines of the label s set in the font of pen p, as found
+// earlier by texpath, if tex is true, or else by textpath, under the current
+// settings.
+bool lookup(const string& s, const pen& p, bool tex, vm::array*& outlines);
+
+// Records the outlines of a label just found by texpath or textpath.
+void store(const string& s, const pen& p, bool tex,
+           const vm::array *outlines);
+
+// Whether setting the label s may change the state of TeX seen by the labels
+// set after it: it uses a command that does, or reads a file, which may.
+bool stateful(const string& s);
+
+} // namespace labelcache
+} // namespace camp
+
+#endif
@@ -37,8 +37,13 @@
 #include "locate.h"
 #include "interact.h"
 #include "process.h"
+#include "server.h"
 
 #include "stack.h"
+#include "sampler.h"
+#include "heap.h"
+#include "shipjobs.h"
+#include "timings.h"
 
 using namespace settings;
 
@@ -117,7 +122,15 @@ void *asymain(void *A)
   Args *args=(Args *) A;
   fpu_trap(trap());
 
-  if(interactive) {
+  mem::heapStats start;
+  timings::start();
+  string profile=getSetting<string>("profile");
+  if(!profile.empty())
+    vm::sampler::start(getSetting<Int>("profilerate"));
+
+  if(!getSetting<string>("server").empty()) {
+    processServer(getSetting<string>("server"));
+  } else if(interactive) {
     Signal(SIGINT,interruptHandler);
     processPrompt();
   } else if (getSetting<bool>("listvariables") && numArgs()==0) {
@@ -126,6 +139,14 @@ void *asymain(void *A)
     } catch(handled_error) {
       em.statusError();
     } 
+  } else if(getSetting<bool>("watch")) {
+    if(numArgs() != 1) {
+      cerr << "-watch needs a single file" << endl;
+      em.statusError();
+    } else {
+      Signal(SIGINT,interruptHandler);
+      processWatch(getArg(0),args->argc,args->argv);
+    }
   } else {
     int n=numArgs();
     if(n == 0) 
@@ -142,6 +163,20 @@ void *asymain(void *A)
       }
   }
 
+  try {
+    camp::waitShipoutJobs();
+  } catch(handled_error) {
+    em.statusError();
+  }
+
+  if(!profile.empty())
+    vm::sampler::stop(profile);
+
+  timings::report();
+
+  if(getSetting<bool>("heapstats"))
+    mem::reportHeap("at exit",start);
+
 #ifdef PROFILE
   vm::dumpProfile();
 #endif
@@ -167,9 +202,20 @@ int main(int argc, char *argv[])
     em.statusError();
   }
   
+  string path=getSetting<string>("connect");
+  if(!path.empty()) {
+    if(interactive) {
+      cerr << "The interactive prompt cannot be run by a server" << endl;
+      exit(1);
+    }
+    exit(server::runClient(path,argc,argv));
+  }
+  
   Args args(argc,argv);
 #ifdef HAVE_GL
-  gl::glthread=getSetting<bool>("threads");
+  // A server forks, which only duplicates the calling thread.
+  gl::glthread=getSetting<bool>("threads") &&
+    getSetting<string>("server").empty();
 #if HAVE_PTHREAD
   
   if(gl::glthread) {
@@ -180,6 +226,7 @@ int main(int argc, char *argv[])
         sigset_t set;
         sigemptyset(&set);
         sigaddset(&set, SIGCHLD);
+        sigaddset(&set, SIGPROF);
         pthread_sigmask(SIG_BLOCK, &set, NULL);
         while(true) {
           camp::glrenderWrapper();
@@ -120,10 +120,26 @@ inline Int Intcast(double x)
   return 0;
 }
   
+// Whether the sum, difference, or product of x and y overflows an Int.
+inline bool sumOverflows(Int x, Int y) {
+  return (y > 0 && x > Int_MAX-y) || (y < 0 && x < Int_MIN-y);
+}
+
+inline bool differenceOverflows(Int x, Int y) {
+  return (y < 0 && x > Int_MAX+y) || (y > 0 && x < Int_MIN+y);
+}
+
+inline bool productOverflows(Int x, Int y) {
+  if(y == 0) return false;
+  if(y < 0) {y=-y; x=-x;}
+  return (y > int_MAX || x > int_MAX/(int) y || x < int_MIN/(int) y) && 
+    (x > Int_MAX/y || x < Int_MIN/y);
+}
+  
 template<>
 struct plus<Int> {
   Int operator() (Int x, Int y, size_t i=0) {
-    if((y > 0 && x > Int_MAX-y) || (y < 0 && x < Int_MIN-y))
+    if(sumOverflows(x,y))
       integeroverflow(i);
     return x+y;
   }
@@ -132,7 +148,7 @@ struct plus<Int> {
 template<>
 struct minus<Int> {
   Int operator() (Int x, Int y, size_t i=0) {
-    if((y < 0 && x > Int_MAX+y) || (y > 0 && x < Int_MIN+y))
+    if(differenceOverflows(x,y))
       integeroverflow(i);
     return x-y;
   }
@@ -141,10 +157,7 @@ struct minus<Int> {
 template<>
 struct times<Int> {
   Int operator() (Int x, Int y, size_t i=0) {
-    if(y == 0) return 0;
-    if(y < 0) {y=-y; x=-x;}
-    if((y > int_MAX || x > int_MAX/(int) y || x < int_MIN/(int) y) && 
-       (x > Int_MAX/y || x < Int_MIN/y))
+    if(productOverflows(x,y))
       integeroverflow(i);
     return x*y;
   }
@@ -117,6 +117,35 @@ namespace mem {
 GC_CONTAINER(list);
 GC_CONTAINER(vector);
 
+// An allocator told, when its container is created, whether the elements
+// hold pointers into the heap.  The storage of a container of pointer-free
+// elements is allocated atomically, so that the collector never scans it.
+template <typename T>
+class atomic_allocator : public gc_allocator<T> {
+  bool atomic;
+public:
+  typedef typename gc_allocator<T>::size_type size_type;
+  typedef typename gc_allocator<T>::pointer pointer;
+
+  template <typename U>
+  struct rebind { typedef atomic_allocator<U> other; };
+
+  atomic_allocator(bool atomic=false) : atomic(atomic) {}
+
+  template <typename U>
+  atomic_allocator(const atomic_allocator<U>& a) : atomic(a.isAtomic()) {}
+
+  bool isAtomic() const {return atomic;}
+
+  pointer allocate(size_type n, const void *hint=0) {
+#ifdef USEGC
+    if(atomic)
+      return static_cast<pointer>(GC_MALLOC_ATOMIC(n*sizeof(T)));
+#endif
+    return gc_allocator<T>::allocate(n,hint);
+  }
+};
+
 template <typename T, typename Container = vector<T> >
 struct stack : public std::stack<T, Container>, public gc {
 };
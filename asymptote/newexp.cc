@@ -130,6 +130,8 @@ types::ty *newArrayExp::trans(coenv &e)
     return primError();
   }
 
+  bool atomic = types::pointerFree(c);
+
   if (dims)
     c = dims->truetype(c);
 
@@ -151,6 +153,7 @@ types::ty *newArrayExp::trans(coenv &e)
     e.c.encode(inst::intpush,
                (Int) ((dimexps ? dimexps->size():0)
                       + (dims ? dims->size():0)));
+    e.c.encode(inst::constpush, (vm::item)atomic);
     e.c.encode(inst::builtin, run::newDeepArray);
 
     return c;
@@ -12,6 +12,8 @@
  *   n - integer
  *   t - item
  *   b - builtin
+ *   v - native entry point of a builtin
+ *   a - native call with its arguments
  *   l - lambda pointer
  *   o - instruction offset
  */
@@ -25,6 +27,7 @@ OPCODE(varsave,'n')
 OPCODE(fieldpush,'n')
 OPCODE(fieldsave,'n')
 OPCODE(builtin,'b')
+OPCODE(native,'v')
 OPCODE(jmp,'o')
 OPCODE(cjmp,'o')
 OPCODE(njmp,'o')
@@ -34,10 +37,31 @@ OPCODE(makefunc,'l')
 OPCODE(ret,'x')
 OPCODE(pushframe,'n')
 OPCODE(popframe,'x')
+OPCODE(closurepush,'n')
+OPCODE(closuresave,'n')
 
 OPCODE(push_default,'x')
 OPCODE(jump_if_not_default,'o')
 
+/* Superinstructions, formed from common pairs of instructions by the peephole
+ * optimizer (see peephole.cc).  The fused instruction keeps its own operand
+ * and the instruction following it is left in place, so that a jump to the
+ * second instruction of the pair still runs correctly.  When the fused
+ * instruction runs, it takes the operand of its partner and steps over it.
+ * Likewise, native_args replaces the pushes of the arguments of a native
+ * call and the call, which follow it, and steps over all of them.
+ */
+OPCODE(varpush_builtin,'n')
+OPCODE(constpush_builtin,'t')
+OPCODE(varpush_native,'n')
+OPCODE(constpush_native,'t')
+OPCODE(native_args,'a')
+OPCODE(varpush_fieldpush,'n')
+OPCODE(varsave_pop,'n')
+OPCODE(fieldsave_pop,'n')
+OPCODE(builtin_cjmp,'b')
+OPCODE(builtin_njmp,'b')
+
 #ifdef COMBO
 OPCODE(varpop,'n')
 OPCODE(fieldpop,'n')
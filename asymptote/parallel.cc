@@ -0,0 +1,147 @@
+/*****
+ * parallel.cc
+ *
+ * Runs independent pieces of work on several threads.
+ *****/
+
+#include <csignal>
+#include <unistd.h>
+#include <vector>
+
+#include "parallel.h"
+#include "fpu.h"
+
+namespace parallel {
+
+size_t processors()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  long n=sysconf(_SC_NPROCESSORS_ONLN);
+  if(n > 0) return n;
+#endif
+  return 1;
+}
+
+size_t threads(size_t n, size_t grain, Int requested)
+{
+  size_t max=requested > 0 ? (size_t) requested : processors();
+  size_t wanted=grain > 0 ? n/grain : n;
+  if(wanted > max) wanted=max;
+  return wanted > 0 ? wanted : 1;
+}
+
+namespace {
+
+#ifdef HAVE_PTHREAD
+pthread_key_t running;
+pthread_once_t once=PTHREAD_ONCE_INIT;
+
+void makeKey()
+{
+  pthread_key_create(&running,NULL);
+}
+#endif
+
+struct abandoned {};
+
+struct chunk {
+  task f;
+  void *data;
+  size_t begin,end;
+  bool done;
+};
+
+// Floating-point exceptions are neither trapped nor reported while a chunk
+// runs, since a signal would be handled by whichever thread raised it;
+// instead the chunk is marked as not done.
+void attempt(chunk *c)
+{
+#ifdef HAVE_PTHREAD
+  pthread_setspecific(running,c);
+#endif
+#ifdef HAVE_FEENABLEEXCEPT
+  fenv_t env;
+  feholdexcept(&env);
+#endif
+  try {
+    c->f(c->data,c->begin,c->end);
+    c->done=true;
+  } catch(...) {
+    c->done=false;
+  }
+#ifdef HAVE_FEENABLEEXCEPT
+  if(fetestexcept(fpu_exceptions()))
+    c->done=false;
+  fesetenv(&env);
+#endif
+#ifdef HAVE_PTHREAD
+  pthread_setspecific(running,NULL);
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+// Signals, including those of the profiler, are left to the main thread.
+void *worker(void *arg)
+{
+  sigset_t set;
+  sigfillset(&set);
+  pthread_sigmask(SIG_BLOCK,&set,0);
+  attempt((chunk *) arg);
+  return 0;
+}
+#endif
+
+} // private
+
+void run(task f, void *data, size_t n, size_t threads)
+{
+#ifdef HAVE_PTHREAD
+  if(threads > n) threads=n;
+  if(threads > 1) {
+    pthread_once(&once,makeKey);
+    std::vector<chunk> chunks(threads);
+    std::vector<pthread_t> ids(threads);
+    std::vector<bool> started(threads,false);
+    for(size_t i=0; i < threads; ++i) {
+      chunk& c=chunks[i];
+      c.f=f;
+      c.data=data;
+      c.begin=n*i/threads;
+      c.end=n*(i+1)/threads;
+      c.done=false;
+    }
+    for(size_t i=1; i < threads; ++i)
+      started[i]=pthread_create(&ids[i],NULL,worker,&chunks[i]) == 0;
+    attempt(&chunks[0]);
+    for(size_t i=1; i < threads; ++i)
+      if(started[i])
+        pthread_join(ids[i],NULL);
+
+    for(size_t i=0; i < threads; ++i) {
+      chunk& c=chunks[i];
+      if(!c.done)
+        f(data,c.begin,c.end);
+    }
+    return;
+  }
+#endif
+  f(data,0,n);
+}
+
+bool concurrent()
+{
+#ifdef HAVE_PTHREAD
+  pthread_once(&once,makeKey);
+  return pthread_getspecific(running) != NULL;
+#else
+  return false;
+#endif
+}
+
+void serial()
+{
+  if(concurrent())
+    throw abandoned();
+}
+
+} // namespace parallel
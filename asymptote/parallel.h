@@ -0,0 +1,44 @@
+/*****
+ * parallel.h
+ *
+ * Runs independent pieces of work on several threads.
+ *****/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "common.h"
+
+namespace parallel {
+
+// Works on the elements from begin up to, but not including, end.  Each
+// element must be worked on independently of the others, and a task that
+// runs asymptote code must give each thread its own stack.
+typedef void (*task)(void *data, size_t begin, size_t end);
+
+// The number of processors online.
+size_t processors();
+
+// The number of threads to use for n elements, giving each thread at least
+// grain elements.  Asking for zero threads asks for one per processor.
+size_t threads(size_t n, size_t grain, Int requested);
+
+// Splits n elements into consecutive chunks run by the given number of
+// threads, and waits until all are done.  A chunk that throws an exception
+// or raises a trapped floating-point exception is run again on the calling
+// thread, so that errors are reported as though the task had been run
+// there from the start.
+void run(task f, void *data, size_t n, size_t threads);
+
+// Whether the calling thread is running a chunk alongside others.  Such a
+// chunk may not report errors or warnings, nor use state shared between
+// threads, so code that would calls serial() first.
+bool concurrent();
+
+// Abandons a chunk running alongside others, which is then run again on the
+// calling thread once the others are done; otherwise does nothing.
+void serial();
+
+} // namespace parallel
+
+#endif
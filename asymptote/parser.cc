@@ -17,6 +17,7 @@
 #include "locate.h"
 #include "errormsg.h"
 #include "parser.h"
+#include "timings.h"
 
 // The lexical analysis and parsing functions used by parseFile.
 void setlexer(size_t (*input) (char* bif, size_t max_size), string filename);
@@ -63,6 +64,7 @@ absyntax::file *doParse(size_t (*input) (char* bif, size_t max_size),
   setlexer(input,filename);
   absyntax::file *root = yyparse() == 0 ? absyntax::root : 0;
   absyntax::root = 0;
+  absyntax::releaseNodes();
   yy::sbuf = 0;
 
   if (!root) {
@@ -95,6 +97,7 @@ absyntax::file *parseStdin()
 absyntax::file *parseFile(const string& filename,
                           const char *nameOfAction)
 {
+  timings::phase t(timings::PARSE);
   if(filename == "-")
     return parseStdin();
   
@@ -136,6 +139,7 @@ absyntax::file *parseString(const string& code,
                             const string& filename,
                             bool extendable)
 {
+  timings::phase t(timings::PARSE);
   debug(false);
   stringbuf buf(code);
   yy::sbuf = &buf;
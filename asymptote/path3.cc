@@ -718,8 +718,6 @@ path3 concat(const path3& p1, const path3& p2)
 
   if (n1 == -1) return p2;
   if (n2 == -1) return p1;
-  triple a=p1.point(n1);
-  triple b=p2.point((Int) 0);
 
   mem::vector<solvedKnot3> nodes(n1+n2+1);
 
@@ -243,7 +243,6 @@ public:
 
   triple preaccel(Int t) const {
     if(!cycles && t <= 0) return triple(0,0,0);
-    triple z0=point(t-1);
     triple c0=postcontrol(t-1);
     triple c1=precontrol(t);
     triple z1=point(t);
@@ -0,0 +1,525 @@
+/*****
+ * pdffile.cc
+ *
+ * Writes a picture without labels straight to a PDF file, with the PDF
+ * counterparts of the PostScript operators of psfile, so that Ghostscript
+ * need not convert it.
+ *****/
+
+#include <ctime>
+#include <zlib.h>
+
+#include "pdffile.h"
+#include "settings.h"
+#include "errormsg.h"
+
+using std::ofstream;
+using std::setw;
+using vm::array;
+using vm::read;
+
+namespace camp {
+
+static const char *inconsistent="inconsistent colorspaces";
+static const char *rectangular="matrix is not rectangular";
+
+pdffile::pdffile(const string& filename)
+  : psfile(&content,filename,true), supported(true)
+{
+  content.setf(std::ios::boolalpha);
+}
+
+pdffile::~pdffile()
+{
+  // The content stream is gone before psfile is destroyed.
+  out=NULL;
+}
+
+// Adds an object, returning a reference to it.
+string pdffile::object(const string& body)
+{
+  objects.push_back(body);
+  ostringstream buf;
+  buf << firstobject+objects.size()-1 << " 0 R";
+  return buf.str();
+}
+
+// Adds a stream object with the given entries, compressing its data.
+string pdffile::stream(const string& entries, const string& data)
+{
+  uLongf size=compressBound(data.size());
+  Bytef *compressed=new Bytef[size];
+  if(compress(compressed,&size,(const Bytef *) data.data(),data.size()) !=
+     Z_OK)
+    reportError("PDF compression failed");
+
+  ostringstream buf;
+  buf << "<< " << entries << " /Filter /FlateDecode /Length " << size
+      << " >>" << newl << "stream" << newl;
+  buf.write((const char *) compressed,size);
+  buf << newl << "endstream";
+  delete[] compressed;
+  return object(buf.str());
+}
+
+// Paints the shading with the given reference.
+void pdffile::shade(const string& ref)
+{
+  shadings.push_back(ref);
+  *out << "/Sh" << shadings.size()-1 << " sh" << newl;
+}
+
+void pdffile::setopacity(const pen& p)
+{
+  if(p.blend() != lastpen.blend() || p.opacity() != lastpen.opacity()) {
+    ostringstream buf;
+    buf << "<< /BM /" << p.blend() << " /CA " << p.opacity() << " /ca "
+        << p.opacity() << " >>";
+    string& name=states[buf.str()];
+    if(name.empty()) {
+      ostringstream n;
+      n << "GS" << states.size()-1;
+      name=n.str();
+    }
+    *out << "/" << name << " gs" << newl;
+    transparency=true;
+  }
+
+  lastpen.settransparency(p);
+}
+
+namespace {
+
+bool samecolor(const pen& p, const pen& q)
+{
+  if(p.cmyk())
+    return q.cmyk() && p.cyan() == q.cyan() && p.magenta() == q.magenta() &&
+      p.yellow() == q.yellow() && p.black() == q.black();
+  if(p.rgb())
+    return q.rgb() && p.red() == q.red() && p.green() == q.green() &&
+      p.blue() == q.blue();
+  if(p.grayscale())
+    return q.grayscale() && p.gray() == q.gray();
+  return true;
+}
+
+}
+
+// PDF, unlike PostScript, keeps separate colors for stroking and filling.
+void pdffile::setpen(pen p)
+{
+  p.convert();
+
+  setopacity(p);
+
+  if(!p.fillpattern().empty())
+    supported=false;
+  else if(!samecolor(p,lastpen)) {
+    write(p);
+    *out << (p.cmyk() ? " K " : p.rgb() ? " RG " : " G ");
+    write(p);
+    *out << (p.cmyk() ? " k" : p.rgb() ? " rg" : " g") << newl;
+  }
+
+  if(p.width() != lastpen.width())
+    *out << p.width() << " w" << newl;
+
+  if(p.cap() != lastpen.cap())
+    *out << p.cap() << " J" << newl;
+
+  if(p.join() != lastpen.join())
+    *out << p.join() << " j" << newl;
+
+  if(p.miter() != lastpen.miter())
+    *out << p.miter() << " M" << newl;
+
+  const LineType *linetype=p.linetype();
+  const LineType *lastlinetype=lastpen.linetype();
+
+  if(!(linetype->pattern == lastlinetype->pattern) ||
+     linetype->offset != lastlinetype->offset) {
+    out->setf(std::ios::fixed);
+    *out << linetype->pattern << " " << linetype->offset << " d" << newl;
+    out->unsetf(std::ios::fixed);
+  }
+
+  lastpen=p;
+}
+
+void pdffile::writepath()
+{
+  size_t j=0;
+  for(size_t i=0; i < ops.size(); ++i) {
+    switch(ops[i]) {
+      case 'm':
+        psfile::moveto(points[j++]);
+        break;
+      case 'l':
+        psfile::lineto(points[j++]);
+        break;
+      case 'c':
+        psfile::curveto(points[j],points[j+1],points[j+2]);
+        j += 3;
+        break;
+      case 'h':
+        psfile::closepath();
+        break;
+    }
+  }
+  ops.clear();
+  points.clear();
+}
+
+// A pen transform is applied between the construction of a path and its
+// stroking; the path built so far is moved to the new coordinates.
+void pdffile::concat(transform t)
+{
+  if(t.isIdentity()) return;
+  if(!ops.empty()) {
+    if(!t.invertible()) {
+      supported=false;
+      return;
+    }
+    transform T=inverse(t);
+    for(size_t i=0; i < points.size(); ++i)
+      points[i]=T*points[i];
+  }
+  psfile::concat(t);
+}
+
+void pdffile::latticeshade(const array& a, const transform& t)
+{
+  size_t n=a.size();
+  if(n == 0) return;
+
+  array *a0=read<array *>(a,0);
+  size_t m=a0->size();
+  setfirstopacity(*a0);
+
+  ColorSpace colorspace=maxcolorspace2(a);
+  checkColorSpace(colorspace);
+
+  size_t ncomponents=ColorComponents[colorspace];
+
+  beginImage(ncomponents*m*n);
+  for(size_t i=n; i > 0;) {
+    array *ai=read<array *>(a,--i);
+    checkArray(ai);
+    if(ai->size() != m) reportError(rectangular);
+    for(size_t j=0; j < m; j++) {
+      pen *p=read<pen *>(ai,j);
+      p->convert();
+      if(!p->promote(colorspace))
+        reportError(inconsistent);
+      write(p,ncomponents);
+    }
+  }
+  string data((const char *) buffer,count);
+  delete[] buffer;
+
+  ostringstream range;
+  for(size_t i=0; i < ncomponents; ++i)
+    range << "0 1 ";
+
+  ostringstream entries;
+  entries << "/FunctionType 0 /Order 1 /Domain [0 1 0 1] /Range ["
+          << range.str() << "] /Decode [" << range.str()
+          << "] /BitsPerSample 8 /Size [" << m << " " << n << "]";
+  string function=stream(entries.str(),data);
+
+  ostringstream buf;
+  buf << "<< /ShadingType 1 /Matrix [";
+  std::ostream *save=out;
+  out=&buf;
+  write(t);
+  out=save;
+  buf << "] /ColorSpace /Device" << ColorDeviceSuffix[colorspace]
+      << " /Function " << function << " >>";
+  shade(object(buf.str()));
+}
+
+// The clipping path was already ended by endpsclip.
+void pdffile::gradientshade(bool axial, ColorSpace colorspace,
+                            const pen& pena, const pair& a, double ra,
+                            bool extenda, const pen& penb, const pair& b,
+                            double rb, bool extendb)
+{
+  setopacity(pena);
+
+  ostringstream buf;
+  buf.setf(std::ios::boolalpha);
+  std::ostream *save=out;
+  out=&buf;
+  gradient(axial,colorspace,pena,a,ra,extenda,penb,b,rb,extendb);
+  out=save;
+  shade(object(buf.str()));
+}
+
+namespace {
+
+// Appends x, mapped from [min,max] to the unsigned integers of 32 bits, in
+// big-endian order.
+void coordinate(string& data, double x, double min, double max)
+{
+  double f=(x-min)/(max-min)*4294967295.0+0.5;
+  unsigned long n=f <= 0.0 ? 0 : f >= 4294967295.0 ? 4294967295UL :
+    (unsigned long) f;
+  for(int shift=24; shift >= 0; shift -= 8)
+    data += (char) ((n >> shift) & 0xff);
+}
+
+// Appends a color component of 16 bits.
+void component(string& data, double c)
+{
+  if(c < 0.0) c=0.0;
+  else if(c > 1.0) c=1.0;
+  unsigned n=(unsigned) (c*65535.0+0.5);
+  data += (char) (n >> 8);
+  data += (char) (n & 0xff);
+}
+
+}
+
+// Adds a mesh shading of the given type, whose stream holds records each of
+// a flag, points, and colors, returning a reference to it.
+string pdffile::mesh(int type, const mem::vector<unsigned char>& flags,
+                     const mem::vector<pair>& points,
+                     const mem::vector<pen *>& colors, ColorSpace colorspace)
+{
+  size_t n=flags.size();
+  size_t npoints=points.size()/n;
+  size_t ncolors=colors.size()/n;
+
+  bbox b;
+  for(size_t i=0; i < points.size(); ++i)
+    b += points[i];
+  if(b.right == b.left) b.right += 1.0;
+  if(b.top == b.bottom) b.top += 1.0;
+
+  string data;
+  for(size_t i=0; i < n; ++i) {
+    data += (char) flags[i];
+    for(size_t j=0; j < npoints; ++j) {
+      const pair& z=points[npoints*i+j];
+      coordinate(data,z.getx(),b.left,b.right);
+      coordinate(data,z.gety(),b.bottom,b.top);
+    }
+    for(size_t j=0; j < ncolors; ++j) {
+      pen *p=colors[ncolors*i+j];
+      p->convert();
+      if(!p->promote(colorspace))
+        reportError(inconsistent);
+      if(p->cmyk()) {
+        component(data,p->cyan());
+        component(data,p->magenta());
+        component(data,p->yellow());
+        component(data,p->black());
+      } else if(p->rgb()) {
+        component(data,p->red());
+        component(data,p->green());
+        component(data,p->blue());
+      } else if(p->grayscale())
+        component(data,p->gray());
+    }
+  }
+
+  ostringstream entries;
+  entries << "/ShadingType " << type << " /ColorSpace /Device"
+          << ColorDeviceSuffix[colorspace]
+          << " /BitsPerCoordinate 32 /BitsPerComponent 16 /BitsPerFlag 8"
+          << " /Decode [" << b.left << " " << b.right << " " << b.bottom
+          << " " << b.top;
+  for(size_t i=0; i < ColorComponents[colorspace]; ++i)
+    entries << " 0 1";
+  entries << "]";
+  return stream(entries.str(),data);
+}
+
+void pdffile::gouraudshade(const pen& pentype, const array& pens,
+                           const array& vertices, const array& edges)
+{
+  size_t size=pens.size();
+  if(size == 0) return;
+
+  setfirstopacity(pens);
+  ColorSpace colorspace=maxcolorspace(pens);
+  checkColorSpace(colorspace);
+
+  mem::vector<unsigned char> flags(size);
+  mem::vector<pair> points(size);
+  mem::vector<pen *> colors(size);
+  for(size_t i=0; i < size; i++) {
+    flags[i]=read<Int>(edges,i);
+    points[i]=read<pair>(vertices,i);
+    colors[i]=read<pen *>(pens,i);
+  }
+
+  shade(mesh(4,flags,points,colors,colorspace));
+}
+
+void pdffile::tensorshade(const pen& pentype, const array& pens,
+                          const array& boundaries, const array& z)
+{
+  size_t size=pens.size();
+  if(size == 0) return;
+  size_t nz=z.size();
+
+  array *p0=read<array *>(pens,0);
+  if(checkArray(p0) != 4)
+    reportError("4 pens required");
+  setfirstopacity(*p0);
+
+  ColorSpace colorspace=maxcolorspace2(pens);
+  checkColorSpace(colorspace);
+
+  mem::vector<unsigned char> flags(size);
+  mem::vector<pair> points;
+  mem::vector<pen *> colors;
+  for(size_t i=0; i < size; i++) {
+    // As in psfile, every patch is new.
+    flags[i]=0;
+    path g=read<path>(boundaries,i);
+    if(!(g.cyclic() && g.size() == 4))
+      reportError("specify cyclic path of length 4");
+    for(Int j=4; j > 0; --j) {
+      points.push_back(g.point(j));
+      points.push_back(g.precontrol(j));
+      points.push_back(g.postcontrol(j-1));
+    }
+    if(nz == 0) { // Coons patch
+      static double nineth=1.0/9.0;
+      for(Int j=0; j < 4; ++j) {
+        points.push_back(nineth*(-4.0*g.point(j)+6.0*(g.precontrol(j)+
+                                                      g.postcontrol(j))
+                                 -2.0*(g.point(j-1)+g.point(j+1))
+                                 +3.0*(g.precontrol(j-1)+g.postcontrol(j+1))
+                                 -g.point(j+2)));
+      }
+    } else {
+      array *zi=read<array *>(z,i);
+      if(checkArray(zi) != 4)
+        reportError("specify 4 internal control points for each path");
+      points.push_back(read<pair>(zi,0));
+      points.push_back(read<pair>(zi,3));
+      points.push_back(read<pair>(zi,2));
+      points.push_back(read<pair>(zi,1));
+    }
+
+    array *pi=read<array *>(pens,i);
+    if(checkArray(pi) != 4)
+      reportError("specify 4 pens for each path");
+    colors.push_back(read<pen *>(pi,0));
+    colors.push_back(read<pen *>(pi,3));
+    colors.push_back(read<pen *>(pi,2));
+    colors.push_back(read<pen *>(pi,1));
+  }
+
+  shade(mesh(7,flags,points,colors,colorspace));
+}
+
+void pdffile::imageheader(size_t, size_t, ColorSpace colorspace)
+{
+  imagecolorspace=colorspace;
+}
+
+// PostScript images, with the matrices given by psfile, begin at the
+// bottom; PDF images begin at the top.  The dimensions are those of the
+// data written, which the header need not give.
+void pdffile::outImage(bool antialias, size_t width, size_t height,
+                       size_t ncomponents)
+{
+  if(antialias) dealias(buffer,width,height,ncomponents);
+
+  ostringstream entries;
+  entries << "/Type /XObject /Subtype /Image /Width " << width
+          << " /Height " << height << " /ColorSpace /Device"
+          << ColorDeviceSuffix[imagecolorspace] << " /BitsPerComponent 8";
+  images.push_back(stream(entries.str(),
+                          string((const char *) buffer,count)));
+  *out << "q 1 0 0 -1 0 1 cm /Im" << images.size()-1 << " Do Q" << newl;
+}
+
+string pdffile::resources()
+{
+  ostringstream buf;
+  buf << "<< /ProcSet [/PDF /ImageB /ImageC]";
+  if(!states.empty()) {
+    buf << " /ExtGState <<";
+    for(mem::map<string,string>::iterator p=states.begin();
+        p != states.end(); ++p)
+      buf << " /" << p->second << " " << p->first;
+    buf << " >>";
+  }
+  if(!shadings.empty()) {
+    buf << " /Shading <<";
+    for(size_t i=0; i < shadings.size(); ++i)
+      buf << " /Sh" << i << " " << shadings[i];
+    buf << " >>";
+  }
+  if(!images.empty()) {
+    buf << " /XObject <<";
+    for(size_t i=0; i < images.size(); ++i)
+      buf << " /Im" << i << " " << images[i];
+    buf << " >>";
+  }
+  buf << " >>";
+  return buf.str();
+}
+
+void pdffile::close()
+{
+  if(!supported || filename.empty()) return;
+
+  string contents=stream("",content.str());
+
+  ostringstream page;
+  page << std::setprecision(9)
+       << "<< /Type /Page /Parent 2 0 R /MediaBox [" << box << "]"
+       << " /Resources " << resources() << " /Contents " << contents;
+  if(transparency)
+    page << " /Group << /Type /Group /S /Transparency >>";
+  page << " >>";
+
+  time_t t; time(&t);
+  struct tm *tt=localtime(&t);
+  ostringstream info;
+  info << "<< /Creator (" << settings::PROGRAM << " " << settings::VERSION
+       << SVN_REVISION << ") /CreationDate (D:" << std::setfill('0')
+       << tt->tm_year+1900 << setw(2) << tt->tm_mon+1 << setw(2)
+       << tt->tm_mday << setw(2) << tt->tm_hour << setw(2) << tt->tm_min
+       << setw(2) << tt->tm_sec << ") >>";
+
+  mem::vector<string> body;
+  body.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+  body.push_back("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  body.push_back(page.str());
+  body.push_back(info.str());
+  body.insert(body.end(),objects.begin(),objects.end());
+
+  ostringstream file;
+  file << "%PDF-1.4" << newl << "%\342\343\317\323" << newl;
+  mem::vector<size_t> offsets;
+  for(size_t i=0; i < body.size(); ++i) {
+    offsets.push_back(file.tellp());
+    file << i+1 << " 0 obj" << newl << body[i] << newl << "endobj" << newl;
+  }
+  size_t xref=file.tellp();
+  file << "xref" << newl << "0 " << body.size()+1 << newl
+       << "0000000000 65535 f " << newl;
+  file.fill('0');
+  for(size_t i=0; i < offsets.size(); ++i)
+    file << setw(10) << offsets[i] << " 00000 n " << newl;
+  file << "trailer" << newl << "<< /Size " << body.size()+1
+       << " /Root 1 0 R /Info 4 0 R >>" << newl << "startxref" << newl
+       << xref << newl << "%%EOF" << newl;
+
+  ofstream fout(filename.c_str(),std::ios::binary);
+  string s=file.str();
+  fout.write(s.data(),s.size());
+  fout.close();
+  if(!fout)
+    reportError("Cannot write to "+filename);
+  filename.clear();
+}
+
+} //namespace camp
@@ -0,0 +1,146 @@
+/*****
+ * pdffile.h
+ *
+ * Writes a picture without labels straight to a PDF file, with the PDF
+ * counterparts of the PostScript operators of psfile, so that Ghostscript
+ * need not convert it.
+ *****/
+
+#ifndef PDFFILE_H
+#define PDFFILE_H
+
+#include "psfile.h"
+
+namespace camp {
+
+class pdffile : public psfile {
+  ostringstream content;
+  bbox box;
+
+  // Whether everything drawn so far could be written as PDF.
+  bool supported;
+
+  // The objects after the page and its document information, which are
+  // numbered from firstobject.
+  static const size_t firstobject=5;
+  mem::vector<string> objects;
+
+  // The resources of the page: graphics states, named for their entries,
+  // and shadings and images, each named for its index.
+  mem::map<string,string> states;
+  mem::vector<string> shadings;
+  mem::vector<string> images;
+
+  // The path being built, of operators m, l, c, and h and their points.
+  // PDF allows no change to the graphics state between the construction of
+  // a path and its painting, so the path is written only when painted.
+  string ops;
+  mem::vector<pair> points;
+
+  // The image being written.
+  ColorSpace imagecolorspace;
+
+  string object(const string& body);
+  string stream(const string& entries, const string& data);
+  void shade(const string& ref);
+  string mesh(int type, const mem::vector<unsigned char>& flags,
+              const mem::vector<pair>& points,
+              const mem::vector<pen *>& colors, ColorSpace colorspace);
+  string resources();
+  void writepath();
+
+public:
+  pdffile(const string& filename);
+  ~pdffile();
+
+  // Whether the picture could be written as PDF; if not, close writes
+  // nothing.
+  bool Supported() {
+    return supported;
+  }
+
+  void prologue(const bbox& b) {
+    box=b;
+  }
+
+  void epilogue() {}
+  void close();
+
+  void setpen(pen p);
+  void setopacity(const pen& p);
+
+  void moveto(pair z) {
+    ops += 'm';
+    points.push_back(z);
+  }
+
+  void lineto(pair z) {
+    ops += 'l';
+    points.push_back(z);
+  }
+
+  void curveto(pair zp, pair zm, pair z1) {
+    ops += 'c';
+    points.push_back(zp);
+    points.push_back(zm);
+    points.push_back(z1);
+  }
+
+  void closepath() {
+    ops += 'h';
+  }
+
+  void stroke(const pen& p, bool dot=false) {
+    writepath();
+    psfile::stroke(p,dot);
+  }
+
+  void strokepath() {
+    supported=false;
+  }
+
+  void fill(const pen& p) {
+    writepath();
+    psfile::fill(p);
+  }
+
+  void endclip(const pen& p) {
+    writepath();
+    psfile::endclip(p);
+  }
+
+  void translate(pair z) {
+    concat(shift(z));
+  }
+
+  void concat(transform t);
+
+  void verbatimline(const string&) {
+    supported=false;
+  }
+
+  void verbatim(const string&) {
+    supported=false;
+  }
+
+  void latticeshade(const vm::array& a, const transform& t);
+
+  void gradientshade(bool axial, ColorSpace colorspace,
+                     const pen& pena, const pair& a, double ra,
+                     bool extenda, const pen& penb, const pair& b,
+                     double rb, bool extendb);
+
+  void gouraudshade(const pen& pentype, const vm::array& pens,
+                    const vm::array& vertices, const vm::array& edges);
+
+  void tensorshade(const pen& pentype, const vm::array& pens,
+                   const vm::array& boundaries, const vm::array& z);
+
+  void imageheader(size_t width, size_t height, ColorSpace colorspace);
+  void outImage(bool antialias, size_t width, size_t height,
+                size_t ncomponents);
+};
+
+} //namespace camp
+
+#endif
@@ -0,0 +1,257 @@
+/*****
+ * peephole.cc
+ *
+ * A peephole optimizer for the code generated by the coder.
+ *****/
+
+#include "peephole.h"
+
+namespace vm {
+
+namespace {
+
+// Longest chain of unconditional jumps that will be followed.  This also
+// guards against loops consisting only of jumps.
+const size_t MAX_JUMP_CHAIN = 16;
+
+bool isJump(inst::opcode op)
+{
+  return op == inst::jmp || op == inst::cjmp || op == inst::njmp ||
+#ifdef COMBO
+    op == inst::gejmp ||
+#endif
+    op == inst::jump_if_not_default;
+}
+
+size_t target(program *code, inst& i)
+{
+  return (size_t) offset(code->begin(), get<program::label>(i));
+}
+
+// A conditional jump on a constant, such as the test of if(false) or
+// while(true), either always or never jumps.  The pair is replaced by an
+// unconditional jump or by nothing, unless something jumps straight to the
+// conditional jump.
+void foldConstantJumps(program *code)
+{
+  size_t n = code->size();
+  mem::vector<bool> jumpedTo(n+1, false);
+  for (program::label l = code->begin(); l != code->end(); ++l)
+    if (isJump(l->op))
+      jumpedTo[target(code, *l)] = true;
+
+  for (size_t k = 1; k < n; ++k) {
+    inst& jump = *code->at(k);
+    if ((jump.op != inst::cjmp && jump.op != inst::njmp) || jumpedTo[k])
+      continue;
+    inst& push = *code->at(k-1);
+    if (push.op != inst::constpush)
+      continue;
+
+    bool value;
+    try {
+      value = get<bool>(push.ref);
+    } catch (bad_item_value&) {
+      continue;
+    }
+
+    push.op = inst::nop;
+    jump.op = (value == (jump.op == inst::cjmp)) ? inst::jmp : inst::nop;
+  }
+}
+
+// Removes the no-ops, jumps to the next instruction and the instructions that
+// cannot be reached from the start of the code, moving the targets of the
+// remaining jumps.  Returns true if any instruction was removed.
+bool removeDeadCode(program *code)
+{
+  size_t n = code->size();
+  mem::vector<bool> live(n, false);
+
+  mem::vector<size_t> todo;
+  todo.push_back(0);
+  while (!todo.empty()) {
+    size_t k = todo.back();
+    todo.pop_back();
+
+    for (; k < n && !live[k]; ++k) {
+      live[k] = true;
+      inst& i = *code->at(k);
+      if (i.op == inst::jmp && target(code, i) == k+1)
+        i.op = inst::nop;
+      if (isJump(i.op))
+        todo.push_back(target(code, i));
+      if (i.op == inst::jmp || i.op == inst::ret)
+        break;
+    }
+  }
+
+  // The new position of each instruction, or of the next one kept for those
+  // that are removed.
+  mem::vector<size_t> moved(n+1);
+  size_t m = 0;
+  for (size_t k = 0; k < n; ++k) {
+    moved[k] = m;
+    if (live[k] && code->at(k)->op != inst::nop)
+      ++m;
+  }
+  moved[n] = m;
+
+  if (m == n)
+    return false;
+
+  for (size_t k = 0; k < n; ++k) {
+    inst& i = *code->at(k);
+    if (!live[k] || i.op == inst::nop)
+      continue;
+    if (isJump(i.op))
+      i.ref = code->at(moved[target(code, i)]);
+    *code->at(moved[k]) = i;
+  }
+  code->resize(m);
+  return true;
+}
+
+// If the jump lands on an unconditional jump, send it straight on to the final
+// destination.
+void threadJump(program *code, inst& i)
+{
+  program::label target = get<program::label>(i);
+  program::label end = code->end();
+
+  for (size_t n = 0; n < MAX_JUMP_CHAIN; ++n) {
+    if (target == end || target->op != inst::jmp)
+      break;
+    program::label next = get<program::label>(*target);
+    if (next == target)
+      break;
+    target = next;
+  }
+
+  i.ref = target;
+}
+
+// Replaces a native call whose arguments are all pushed from variables or
+// constants just before it by a native_args instruction, which reads them
+// straight from the frame.  A call of one argument is left to be fused as a
+// pair.
+void fuseNativeCalls(program *code)
+{
+  size_t n = code->size();
+  for (size_t k = 0; k < n; ++k) {
+    inst& call = *code->at(k);
+    if (call.op != inst::native)
+      continue;
+
+    const nativeEntry *e = get<const nativeEntry *>(call);
+    size_t arity = e->arity;
+    if (arity < 2 || arity > nativeCall::MAXARGS || arity > k)
+      continue;
+
+    size_t start = k-arity;
+    bool simple = true;
+    for (size_t j = start; j < k; ++j) {
+      inst::opcode op = code->at(j)->op;
+      if (op != inst::varpush && op != inst::constpush && op != inst::intpush)
+        simple = false;
+    }
+    if (!simple)
+      continue;
+
+    nativeCall *c = new nativeCall;
+    c->entry = e;
+    for (size_t j = 0; j < arity; ++j) {
+      inst& push = *code->at(start+j);
+      if (push.op == inst::varpush)
+        c->var[j] = get<Int>(push);
+      else {
+        c->var[j] = -1;
+        c->value[j] = push.ref;
+      }
+    }
+
+    inst& first = *code->at(start);
+    first.op = inst::native_args;
+    first.ref = c;
+  }
+}
+
+// Returns the superinstruction for the pair (first, second), or nop if the
+// pair cannot be fused.
+inst::opcode fuse(inst::opcode first, inst::opcode second)
+{
+  switch (first) {
+    case inst::varpush:
+      if (second == inst::builtin)
+        return inst::varpush_builtin;
+      if (second == inst::native)
+        return inst::varpush_native;
+      if (second == inst::fieldpush)
+        return inst::varpush_fieldpush;
+      break;
+
+    case inst::varsave:
+      if (second == inst::pop)
+        return inst::varsave_pop;
+      break;
+
+    case inst::fieldsave:
+      if (second == inst::pop)
+        return inst::fieldsave_pop;
+      break;
+
+    case inst::constpush:
+    case inst::intpush:
+      if (second == inst::builtin)
+        return inst::constpush_builtin;
+      if (second == inst::native)
+        return inst::constpush_native;
+      break;
+
+    case inst::builtin:
+      if (second == inst::cjmp)
+        return inst::builtin_cjmp;
+      if (second == inst::njmp)
+        return inst::builtin_njmp;
+      break;
+
+    default:
+      break;
+  }
+  return inst::nop;
+}
+
+} // private
+
+void optimize(program *code)
+{
+  foldConstantJumps(code);
+  removeDeadCode(code);
+
+  for (program::label l = code->begin(); l != code->end(); ++l)
+    if (isJump(l->op))
+      threadJump(code, *l);
+
+  // Threading can leave jumps that are no longer reached, and removing them
+  // can leave jumps to the next instruction.
+  while (removeDeadCode(code))
+    ;
+
+  fuseNativeCalls(code);
+
+  program::label end = code->end();
+
+  // Only the opcode of the first instruction of a pair is changed, so the
+  // second may itself start another pair.
+  for (program::label l = code->begin(); l != end; ++l) {
+    program::label next = l; ++next;
+    if (next == end)
+      break;
+
+    inst::opcode op = fuse(l->op, next->op);
+    if (op != inst::nop)
+      l->op = op;
+  }
+}
+
+} // namespace vm
@@ -0,0 +1,25 @@
+/*****
+ * peephole.h
+ *
+ * A peephole optimizer for the code generated by the coder.
+ *****/
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "program.h"
+
+namespace vm {
+
+// Rewrites the finished code of a function in place: conditional jumps on
+// constants are resolved, jumps to unconditional jumps are short-circuited,
+// instructions that can never be run are removed, native calls of variables
+// and constants read them from the frame and common pairs of instructions
+// are fused into the superinstructions listed in opcodes.h.
+// Jumps within the code are moved along with their targets, but any other
+// labels into the code are invalidated.
+void optimize(program *code);
+
+} // namespace vm
+
+#endif // PEEPHOLE_H
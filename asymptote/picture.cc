@@ -8,12 +8,15 @@
 
 #include "errormsg.h"
 #include "picture.h"
+#include "pdffile.h"
 #include "util.h"
 #include "settings.h"
 #include "interact.h"
 #include "drawverbatim.h"
 #include "drawlabel.h"
 #include "drawlayer.h"
+#include "timings.h"
+#include "parallel.h"
 
 using std::ifstream;
 using std::ofstream;
@@ -28,7 +31,7 @@ texstream::~texstream() {
   string name;
   if(!context) 
     name=stripFile(outname());
-  name += "texput.";
+  name += jobname+".";
   unlink((name+"aux").c_str());
   unlink((name+"log").c_str());
   unlink((name+"out").c_str());
@@ -371,10 +374,22 @@ bbox picture::bounds()
     bboxstack.clear();
   }
   
-  if(havelabels()) texinit();
-  
+  bool labels=havelabels();
+  timings::phase t(timings::LABELS,labels);
   nodelist::iterator p=nodes.begin();
   for(size_t i=0; i < lastnumber; ++i) ++p;
+  
+  if(labels) {
+    texdefer();
+    // Measure the new labels together, rather than each as it is reached.
+    labelvector L;
+    for(nodelist::iterator q=p; q != nodes.end(); ++q) {
+      drawLabel *l=dynamic_cast<drawLabel *>(*q);
+      if(l) L.push_back(l);
+    }
+    drawLabel::getbounds(L,processData().tex,getSetting<string>("tex"));
+  }
+  
   for(; p != nodes.end(); ++p) {
     assert(*p);
     (*p)->bounds(b_cached,processData().tex,labelbounds,bboxstack);
@@ -441,8 +456,25 @@ pair picture::ratio(double (*m)(double, double))
   
 void texinit()
 {
+  // The TeX pipe is shared by all threads.
+  parallel::serial();
+  timings::phase t(timings::LABELS);
   drawElement::lastpen=pen(initialpen);
   processDataStruct &pd=processData();
+  // A pipe kept from an earlier run already has the start of the preamble.
+  if(pd.TeXkept) {
+    pd.TeXkept=false;
+    mem::list<string>::iterator p=pd.TeXpipepreamble.begin();
+    mem::list<string>::iterator q=pd.TeXpiped.begin();
+    for(; p != pd.TeXpipepreamble.end() && q != pd.TeXpiped.end() &&
+          *p == *q; ++p, ++q) ;
+    if(q == pd.TeXpiped.end())
+      pd.TeXpipepreamble.erase(pd.TeXpipepreamble.begin(),p);
+    else
+      pd.tex.pipeclose();
+    pd.TeXpiped.clear();
+  }
+  
   // Output any new texpreamble commands
   if(pd.tex.isopen()) {
     if(pd.TeXpipepreamble.empty()) return;
@@ -486,6 +518,15 @@ void texinit()
     cmd.push_back("\\scrollmode");
   }
   
+  // Make tex pipe aware of a previously generated aux file.
+  std::ifstream fin(auxname(outname(),"aux").c_str());
+  if(fin) {
+    std::ofstream fout("texput.aux");
+    string s;
+    while(getline(fin,s))
+      fout << s << endl;
+  }
+
   pd.tex.open(cmd,"texpath",texpathmessage());
   pd.tex.wait("\n*");
   pd.tex << "\n";
@@ -494,6 +535,100 @@ void texinit()
   texdefines(pd.tex,pd.TeXpreamble,true);
   pd.TeXpipepreamble.clear();
 }
+
+namespace {
+bool texdeferred=false;
+}
+
+void texdefer()
+{
+  if(getSetting<bool>("labelcache"))
+    texdeferred=true;
+  else
+    texinit();
+}
+
+void texensure()
+{
+  if(texdeferred) {
+    texdeferred=false;
+    texinit();
+  }
+}
+  
+namespace {
+// Starts a pipe of the pool, with the same preamble as processData().tex.
+texstream *texworker(size_t i)
+{
+  processDataStruct &pd=processData();
+  ostringstream jobname;
+  jobname << "texput" << i;
+  texstream *tex=new texstream(jobname.str());
+  
+  string dir=stripFile(outname());
+  mem::vector<string> cmd;
+  cmd.push_back(texprogram());
+  if(!dir.empty()) 
+    cmd.push_back("-output-directory="+dir.substr(0,dir.length()-1));
+  cmd.push_back("-jobname="+tex->jobname);
+  cmd.push_back("\\scrollmode");
+  
+  std::ifstream fin(auxname(outname(),"aux").c_str());
+  if(fin) {
+    std::ofstream fout((tex->jobname+".aux").c_str());
+    string s;
+    while(getline(fin,s))
+      fout << s << endl;
+  }
+  
+  // The preamble is written without waiting for TeX to start, so that the
+  // pipes of the pool start together.
+  tex->open(cmd,"texpath",texpathmessage());
+  *tex << "\n";
+  texdocumentclass(*tex,true);
+  texdefines(*tex,pd.TeXpreamble,true);
+  tex->preamble=pd.TeXpreamble;
+  tex->lastpen=pen(initialpen);
+  return tex;
+}
+}
+
+size_t texworkers(size_t chunks)
+{
+  processDataStruct &pd=processData();
+  string texengine=getSetting<string>("tex");
+  if(settings::context(texengine) || getSetting<bool>("inlineimage") ||
+     getSetting<bool>("inlinetex"))
+    return 0;
+  
+  Int requested=getSetting<Int>("texpipes");
+  size_t n=requested > 0 ? (size_t) requested : parallel::processors();
+  n=min(n,chunks);
+  if(n <= 1) return 0;
+  --n;
+  
+  texpool &pool=pd.TeXpool;
+  for(size_t i=0; i < n; ++i) {
+    if(i == pool.size())
+      pool.push_back(texworker(i+1));
+    texstream *tex=pool[i];
+    mem::list<string>::iterator p=pd.TeXpreamble.begin();
+    mem::list<string>::iterator q=tex->preamble.begin();
+    for(; p != pd.TeXpreamble.end() && q != tex->preamble.end() && *p == *q;
+        ++p, ++q) ;
+    if(!tex->isopen() || !tex->running() || q != tex->preamble.end()) {
+      delete tex;
+      pool[i]=texworker(i+1);
+    } else if(p != pd.TeXpreamble.end()) {
+      mem::list<string> preamble;
+      for(; p != pd.TeXpreamble.end(); ++p)
+        preamble.push_back(*p);
+      texpreamble(*tex,preamble,false);
+      tex->preamble=pd.TeXpreamble;
+    }
+  }
+  return n;
+}
   
 int opentex(const string& texname, const string& prefix) 
 {
@@ -513,6 +648,7 @@ int opentex(const string& texname, const string& prefix)
     cmd.push_back(stripDir(texname));
   }
     
+  timings::phase t(timings::LATEX);
   bool quiet=verbose <= 1;
   int status=System(cmd,quiet ? 1 : 0,true,"texpath",texpathmessage());
   if(!status && getSetting<bool>("twice"))
@@ -539,12 +675,14 @@ bool picture::texprocess(const string& texname, const string& outname,
   
   if(outfile) {
     outfile.close();
+    timings::wrote(texname);
     
     status=opentex(texname,prefix);
     string texengine=getSetting<string>("tex");
     
     if(status == 0) {
       string dviname=auxname(prefix,"dvi");
+      timings::wrote(dviname);
       mem::vector<string> cmd;
     
       if(svgformat) {
@@ -563,7 +701,9 @@ bool picture::texprocess(const string& texname, const string& outname,
             << B.top << "bp";
         cmd.push_back(buf.str());
         cmd.push_back(dviname);
+        timings::phase t(timings::DVISVGM);
         status=System(cmd,0,true,"dvisvgm");
+        timings::wrote(outname);
         if(!keep)
           unlink(dviname.c_str());
       } else {
@@ -599,7 +739,11 @@ bool picture::texprocess(const string& texname, const string& outname,
           if(verbose <= 1) cmd.push_back("-q");
           cmd.push_back("-o"+psname);
           cmd.push_back(dviname);
-          status=System(cmd,0,true,"dvips");
+          {
+            timings::phase t(timings::DVIPS);
+            status=System(cmd,0,true,"dvips");
+            timings::wrote(psname);
+          }
           if(status == 0) {
             ifstream fin(psname.c_str());
             psfile fout(outname,false);
@@ -712,11 +856,50 @@ int picture::epstopdf(const string& epsname, const string& pdfname)
     oldPath=getPath();
     setPath(dir.c_str());
   }
+  timings::phase t(timings::GS);
   int status=System(cmd,0,true,"gs","Ghostscript");
+  timings::wrote(pdfname);
   if(oldPath != NULL)
     setPath(oldPath);
   return status;
 }
+
+bool picture::writepdf(picture *preamble, const string& pdfname,
+                       const bbox& b, const pair& bboxshift)
+{
+  pdffile out(pdfname);
+  out.prologue(b);
+  out.gsave();
+  out.translate(bboxshift);
+  
+  if(preamble) {
+    nodelist Nodes=preamble->nodes;
+    nodelist::iterator P=Nodes.begin();
+    if(P != Nodes.end()) {
+      out.resetpen();
+      for(; P != Nodes.end(); ++P) {
+        assert(*P);
+        (*P)->draw(&out);
+      }
+    }
+  }
+  out.resetpen();
+  
+  for(nodelist::iterator p=nodes.begin(); p != nodes.end(); ++p) {
+    assert(*p);
+    (*p)->draw(&out);
+  }
+  
+  out.grestore();
+  out.epilogue();
+  out.close();
+  if(!out.Supported()) return false;
+  
+  timings::wrote(pdfname);
+  if(out.Transparency())
+    transparency=true;
+  return true;
+}
   
 bool picture::reloadPDF(const string& Viewer, const string& outname) const 
 {
@@ -785,7 +968,9 @@ bool picture::postprocess(const string& prename, const string& outname,
         push_split(cmd,getSetting<string>("gsOptions"));
         cmd.push_back("-sOutputFile="+outname);
         cmd.push_back(prename);
+        timings::phase t(timings::GS);
         status=System(cmd,0,true,"gs","Ghostscript");
+        timings::wrote(outname);
       } else if(!svgformat) {
         double expand=antialias;
         if(expand < 2.0) expand=1.0;
@@ -800,7 +985,9 @@ bool picture::postprocess(const string& prename, const string& outname,
         cmd.push_back(String(100.0/expand)+"%x");
         cmd.push_back(nativeformat()+":"+prename);
         cmd.push_back(outputformat+":"+outname);
+        timings::phase t(timings::CONVERT);
         status=System(cmd,0,true,"convert");
+        timings::wrote(outname);
       }
     }
     if(!getSetting<bool>("keep"))
@@ -812,6 +999,7 @@ bool picture::postprocess(const string& prename, const string& outname,
     cout << "Wrote " << outname << endl;
   bool View=settings::view() && view;
   if(View) {
+    timings::phase t(timings::VIEW);
     if(epsformat || pdfformat) {
       // Check to see if there is an existing viewer for this outname.
       mem::map<CONST string,int>::iterator p=pids.find(outname);
@@ -879,6 +1067,7 @@ bool picture::shipout(picture *preamble, const string& Prefix,
                       bool wait, bool view)
 {
   b=bounds();
+  timings::phase t(timings::SHIPOUT);
   
   string texengine=getSetting<string>("tex");
   bool usetex=texengine != "none";
@@ -901,14 +1090,30 @@ bool picture::shipout(picture *preamble, const string& Prefix,
   
   bool Labels=labels || TeXmode;
   
+  // Pictures without labels are written straight to PDF, unless options
+  // for Ghostscript are given.
+  bool directpdf=outputformat == "pdf" && !Labels && !xobject &&
+    !standardout && getSetting<bool>("directpdf") &&
+    getSetting<string>("gsOptions").empty();
+  string pdfname=auxname(prefix,"pdf");
+  
   if(b.empty && !Labels) { // Output a null file
     bbox b;
     b.left=b.bottom=0;
     b.right=b.top=xobject ? 18 : 1;
+    if(directpdf) {
+      pdffile out(pdfname);
+      out.prologue(b);
+      out.close();
+      timings::wrote(pdfname);
+      return postprocess(pdfname,outname,outputformat,1.0,wait,view,true,
+                         false);
+    }
     psfile out(epsname,false);
     out.prologue(b);
     out.epilogue();
     out.close();
+    timings::wrote(epsname);
     return postprocess(epsname,outname,outputformat,1.0,wait,view,false,false);
   }
   
@@ -947,6 +1152,17 @@ bool picture::shipout(picture *preamble, const string& Prefix,
     }
   }
   
+  if(directpdf) {
+    bbox bshift=b;
+    bshift.shift(bboxshift);
+    if(writepdf(preamble,pdfname,bshift,bboxshift)) {
+      if(!postprocess(pdfname,outname,outputformat,magnification,wait,view,
+                      true,false))
+        reportError("shipout failed");
+      return true;
+    }
+  }
+  
   bool status=true;
   
   string texname;
@@ -1076,6 +1292,7 @@ bool picture::shipout(picture *preamble, const string& Prefix,
           static pair zero;
           L=new drawLabel(cmd.str(),"",identity,pair(m.getx(),M.gety()),zero,P);
           texinit();
+          timings::phase t(timings::LABELS);
           L->bounds(b_cached,processData().tex,labelbounds,bboxstack);
           postscript=true;
         }
@@ -1089,6 +1306,7 @@ bool picture::shipout(picture *preamble, const string& Prefix,
     
     out.epilogue();
     out.close();
+    timings::wrote(psname);
     
     if(out.Transparency())
       transparency=true;
@@ -1316,6 +1534,7 @@ bool picture::shipout3(const string& prefix, const string& format,
     if(pid == -1)
       camp::reportError("Cannot fork process");
     if(pid != 0)  {
+      timings::spawned();
       oldpid=pid;
       waitpid(pid,NULL,interact::interactive && View ? WNOHANG : 0);
       return true;
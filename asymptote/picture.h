@@ -69,6 +69,11 @@ public:
   
   int epstopdf(const string& epsname, const string& pdfname);
   
+  // Write a picture without labels straight to a PDF file, unless it
+  // draws something that only PostScript can express.
+  bool writepdf(picture *preamble, const string& pdfname, const bbox& b,
+                const pair& bboxshift);
+  
   bool texprocess(const string& texname, const string& tempname,
                   const string& prefix, const pair& bboxshift, bool svgformat); 
     
@@ -116,6 +121,17 @@ inline picture *transformed(const vm::array& t, picture *p)
 }
 
 void texinit();
+
+// Defers texinit, when labels may be found in the label cache, until
+// texensure is called for the first label that is not.
+void texdefer();
+void texensure();
+
+// Readies the pipes of the pool that a batch of labels, sent to TeX in the
+// given number of chunks, is shared among besides processData().tex, and
+// returns how many there are.
+size_t texworkers(size_t chunks);
+
 int opentex(const string& texname, const string& prefix);
 
 const char *texpathmessage();
@@ -33,6 +33,7 @@
 #include "settings.h"
 #include "util.h"
 #include "interact.h"
+#include "timings.h"
 
 // bidirectional stream for reading and writing to pipes
 class iopipestream {
@@ -101,6 +102,7 @@ public:
       kill(0,SIGTERM);
       _exit(-1);
     }
+    timings::spawned();
     close(out[1]);
     close(in[0]);
     *buffer=0;
@@ -147,6 +149,17 @@ public:
     }
   }
   
+  // Forgets the pipe without stopping the process at its other end; used in
+  // a forked child that must not share the pipe with its parent.
+  void detach() {
+    if(pipeopen) {
+      eof();
+      close(out[0]);
+      Running=false;
+      pipeopen=false;
+    }
+  }
+
   virtual ~iopipestream() {
     pipeclose();
   }
@@ -7,6 +7,12 @@
  * running it.
  *****/
 
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
 #include "types.h"
 #include "errormsg.h"
 #include "genv.h"
@@ -18,12 +24,15 @@
 #include "envcompleter.h"
 #include "parser.h"
 #include "fileio.h"
+#include "locate.h"
+#include "timings.h"
 
 #include "stack.h"
 #include "runtime.h"
 #include "texfile.h"
 
 #include "process.h"
+#include "server.h"
 
 namespace camp {
 pen& defaultpen() {
@@ -159,12 +168,17 @@ enum transMode {
 bool runRunnable(runnable *r, coenv &e, istack &s, transMode tm=TRANS_NORMAL) {
   e.e.beginScope();
 
-  lambda *codelet= tm==TRANS_INTERACTIVE ?
-    interactiveRunnable(r).transAsCodelet(e) :
-    r->transAsCodelet(e);
+  lambda *codelet;
+  {
+    timings::phase t(timings::TRANSLATE);
+    codelet= tm==TRANS_INTERACTIVE ?
+      interactiveRunnable(r).transAsCodelet(e) :
+      r->transAsCodelet(e);
+  }
   em.sync();
   if(!em.errors()) {
     if(getSetting<bool>("translate")) print(cout,codelet->code);
+    timings::phase t(timings::RUN);
     s.run(codelet);
 
     // Commits the changes made to the environment.
@@ -206,9 +220,30 @@ public:
   virtual void run(coenv &e, istack &s, transMode tm=TRANS_NORMAL) = 0;
 
   virtual void postRun(coenv &, istack &s) {
+    timings::phase t(timings::RUN);
     run::exitFunction(&s);
   }
 
+  // Runs the core in the given process environment.
+  void runIn(penv &pe, bool purge=false, transMode tm=TRANS_NORMAL) {
+    env base_env(pe.ge());
+    coder base_coder(nullPos, "icore::doRun");
+    coenv e(base_coder,base_env);
+
+    vm::interactiveStack s;
+    s.setInitMap(pe.ge().getInitMap());
+    s.setEnvironment(&e);
+
+    preRun(e,s);
+
+    if(purge) run::purge();
+
+    // Now that everything is set up, run the core.
+    run(e,s,tm);
+
+    postRun(e,s);
+  }
+
   virtual void doRun(bool purge=false, transMode tm=TRANS_NORMAL) {
     em.sync();
     if(em.errors())
@@ -218,22 +253,7 @@ public:
       if(purge) run::purge();
       
       penv pe;
-      env base_env(pe.ge());
-      coder base_coder(nullPos, "icore::doRun");
-      coenv e(base_coder,base_env);
-
-      vm::interactiveStack s;
-      s.setInitMap(pe.ge().getInitMap());
-      s.setEnvironment(&e);
-
-      preRun(e,s);
-
-      if(purge) run::purge();
-
-      // Now that everything is set up, run the core.
-      run(e,s,tm);
-
-      postRun(e,s);
+      runIn(pe,purge,tm);
 
     } catch(std::bad_alloc&) {
       outOfMemory();
@@ -286,6 +306,11 @@ public:
     return name;
   }
 
+  // Parse the code again when it is next needed.
+  void reparse() {
+    cachedTree=0;
+  }
+
   void doParse() {
     block *tree=getTree();
     em.sync();
@@ -368,11 +393,20 @@ public:
     return !filename.empty() ? parser::parseFile(filename,"Loading") : 0;
   }
 
-  void preRun(coenv& e, istack& s) {
+  // Name the output after the file, unless a directory alone was given.
+  void setOutname() {
     outname_save=getSetting<string>("outname");
     if(stripDir(outname_save).empty())
       Setting("outname")=outname_save+outname;
+  }
 
+  void announce() {
+    if (verbose >= 1)
+      cout << "Processing " << outname << endl;
+  }
+
+  void preRun(coenv& e, istack& s) {
+    setOutname();
     itree::preRun(e, s);
   }
 
@@ -389,8 +423,7 @@ public:
     } catch(handled_error) {
     }
 
-    if (verbose >= 1)
-      cout << "Processing " << outname << endl;
+    announce();
     
     try {
       icore::process(purge);
@@ -401,6 +434,216 @@ public:
   }
 };
 
+// The file run by -watch, which is run again whenever it changes, until
+// interrupted.  The file is parsed and translated afresh, but the process
+// environment is kept between runs, so that the modules it imports are
+// translated only once and the TeX pipe stays open.  A change to the file of
+// one of these modules starts again in a new environment.
+class iwatch : public ifile {
+  string filename;
+  int argc;
+  char **argv;
+
+  struct stamp {
+    time_t mtime;
+    off_t size;
+    ino_t ino;
+  };
+  typedef mem::map<CONST string,stamp> stampMap;
+  stampMap stamps;
+
+  static stamp stampOf(const string& file) {
+    struct stat buf;
+    stamp s={0,0,0};
+    if(stat(file.c_str(),&buf) == 0) {
+      s.mtime=buf.st_mtime;
+      s.size=buf.st_size;
+      s.ino=buf.st_ino;
+    }
+    return s;
+  }
+
+  // Waits for one of the files stamped to change, returning whether it was
+  // other than the file watched.
+  bool awaitChange() {
+    for(;;) {
+      usleep(100000);
+      if(errorstream::interrupt) throw interrupted();
+      for(stampMap::iterator p=stamps.begin(); p != stamps.end(); ++p) {
+        stamp s=stampOf(p->first);
+        if(s.mtime != p->second.mtime || s.size != p->second.size ||
+           s.ino != p->second.ino)
+          return p->first != filename;
+      }
+    }
+  }
+
+public:
+  iwatch(const string& name, int argc, char **argv)
+    : ifile(name), filename(settings::locateFile(name)),
+      argc(argc), argv(argv) {}
+
+  void doRun(bool purge=false, transMode tm=TRANS_NORMAL) {
+    try {
+      for(;;) {
+        penv pe;
+        bool modules=false;
+        while(!modules) {
+          stamps.clear();
+          stamps[filename]=stampOf(filename);
+          try {
+            runIn(pe,purge,tm);
+          } catch(std::bad_alloc&) {
+            outOfMemory();
+          } catch(quit) {
+          } catch(handled_error) {
+            em.statusError();
+          }
+          run::cleanup();
+          em.clear();
+          cout.flush();
+
+          const mem::list<string>& files=pe.ge().files();
+          for(mem::list<string>::const_iterator p=files.begin();
+              p != files.end(); ++p)
+            if(!p->empty() && stamps.find(*p) == stamps.end())
+              stamps[*p]=stampOf(*p);
+          modules=awaitChange();
+
+          try {
+            reloadOptions(argc,argv);
+            init();
+          } catch(handled_error) {
+            em.statusError();
+          }
+          reparse();
+          pe.pd()->restart();
+          announce();
+        }
+      }
+    } catch(interrupted&) {
+      em.Interrupt(false);
+    }
+  }
+};
+
+// The server started by -server.  It prepares an environment by running
+// plain, then forks a child for each job sent by a client.  Only the child
+// returns from run, having processed the file of the job in its copy of the
+// prepared environment, so that the rest of doRun and of asymain finish the
+// job as they would for ifile.
+class iserver : public icore {
+  int fd;
+  int client;
+  ifile *job;
+
+public:
+  iserver(int fd)
+    : fd(fd), client(-1), job(0) {}
+
+  int getClient() {
+    return client;
+  }
+
+  void doParse() {}
+  void doList() {}
+
+  void run(coenv &e, istack &s, transMode tm=TRANS_NORMAL) {
+    em.sync();
+    if(em.errors())
+      return;
+
+    if(verbose >= 1)
+      cerr << "Serving jobs" << endl;
+
+    for(;;) {
+      client=server::acceptClient(fd);
+      if(client < 0)
+        continue;
+
+      pid_t pid=fork();
+      if(pid == 0)
+        break;
+      if(pid < 0)
+        cerr << "cannot fork: " << strerror(errno) << endl;
+      close(client);
+    }
+
+    server::forked();
+    close(fd);
+
+    server::job j;
+    if(!server::receiveJob(client,j)) {
+      em.statusError();
+      throw quit();
+    }
+
+    // Start afresh from the directory of the client, as asy itself would.
+    startpath=NULL;
+
+    // The job was sent by a client which has already parsed these options.
+    char **argv=args(j.args,true);
+    reloadOptions((int) j.args.size(),argv);
+    init();
+
+    if(j.file >= numArgs()) {
+      cerr << "malformed job" << endl;
+      em.statusError();
+      throw quit();
+    }
+
+    // plain handles -c as it starts, but it has already been run.
+    if(!getSetting<string>("command").empty()) {
+      runStringEmbedded("string s=settings.command; settings.command=\"\";"
+                        "settings.multipleView=settings.batchView="
+                        "settings.interactiveView;"
+                        "_eval(s+\";\",false,true); exit();",e,s);
+      return;
+    }
+
+    string filename=j.file < 0 ? "-" : getArg(j.file);
+
+    if(getSetting<bool>("parseonly") || getSetting<bool>("listvariables")) {
+      ifile(filename).process();
+      throw quit();
+    }
+
+    job=new ifile(filename);
+    job->setOutname();
+    job->announce();
+    job->run(e,s,tm);
+  }
+
+  void postRun(coenv &e, istack &s) {
+    if(job)
+      job->postRun(e,s);
+  }
+};
+
+void processServer(const string& path)
+{
+  int fd=server::openServer(path);
+  if(fd < 0) {
+    em.statusError();
+    return;
+  }
+
+  iserver S(fd);
+  S.doRun();
+
+  // Otherwise, plain failed to load in the server.
+  if(S.getClient() < 0)
+    return;
+
+  if(getSetting<bool>("wait")) {
+    int status;
+    while(wait(&status) > 0);
+  }
+  cout.flush();
+  cerr.flush();
+  server::sendStatus(S.getClient(),em.processStatus() ? 0 : 1);
+}
+
 // Add a semi-colon terminator, if one is not there.
 string terminateLine(const string line) {
   return (!line.empty() && *(line.rbegin())!=';') ? (line+";") : line;
@@ -876,6 +1119,9 @@ void processCode(absyntax::block *code) {
 void processFile(const string& filename, bool purge) {
   ifile(filename).process(purge);
 }
+void processWatch(const string& filename, int argc, char **argv) {
+  iwatch(filename,argc,argv).process();
+}
 void processPrompt() {
   iprompt().process();
 }
@@ -28,6 +28,14 @@ void processCode(absyntax::block *code);
 void processFile(const string& filename, bool purge=false);
 void processPrompt();
 
+// Process the file, then process it again whenever it or a module it imports
+// changes, until interrupted.  The options are read again from argv each time.
+void processWatch(const string& filename, int argc, char **argv);
+
+// Serve jobs sent by asy -connect over the local socket at path.  This returns
+// only in a child process that has run a job.
+void processServer(const string& path);
+
 // Run the code in its own environment.
 void runCode(absyntax::block *code);
 void runString(const string& s, bool interactiveWrite=false);
@@ -70,7 +78,7 @@ public:
     pointer[index]=NULL;
   }
   
-  ~terminator() {
+  void clear() {
     for(typename Pointer::iterator p=pointer.begin(); p != pointer.end(); ++p) {
       if(*p != NULL) {
         (*p)->~T();
@@ -78,17 +86,40 @@ public:
       }
     }
   }
+  
+  ~terminator() {
+    clear();
+  }
 };
 
 class texstream : public iopipestream {
 public:
+  string jobname; // The name of the files TeX writes.
+  // For a pipe of the pool, the preamble it was given and the pen of the
+  // last label it set.
+  mem::list<string> preamble;
+  camp::pen lastpen;
+  
+  texstream(const string& jobname="texput") : jobname(jobname) {}
   ~texstream();
 };
 
+typedef mem::vector<texstream *> texpool;
+
 struct processDataStruct {
   texstream tex; // Bi-directional pipe to latex (to find label bbox)
+  // Further pipes to latex, which measure batches of labels alongside tex;
+  // see texworkers.
+  texpool TeXpool;
   mem::list<string> TeXpipepreamble;
   mem::list<string> TeXpreamble;
+  // Whether the TeX pipe was kept from an earlier run, having been given the
+  // preamble TeXpiped; see restart.
+  bool TeXkept;
+  mem::list<string> TeXpiped;
+  // Whether a label has changed the state of TeX, so that the labels after
+  // it are not taken from the label cache; see labelcache::cacheable.
+  bool TeXchanged;
   vm::callable *atExitFunction;
   vm::callable *atUpdateFunction;
   vm::callable *atBreakpointFunction;
@@ -103,6 +134,8 @@ struct processDataStruct {
 #endif  
   
   processDataStruct() {
+    TeXkept=false;
+    TeXchanged=false;
     atExitFunction=NULL;
     atUpdateFunction=NULL;
     atBreakpointFunction=NULL;
@@ -110,6 +143,55 @@ struct processDataStruct {
     currentpen=camp::pen();
   }
   
+  ~processDataStruct() {
+    closepool();
+  }
+  
+  void closepool() {
+    for(texpool::iterator p=TeXpool.begin(); p != TeXpool.end(); ++p)
+      delete *p;
+    TeXpool.clear();
+  }
+  
+  // Forgets the TeX pipes without stopping the processes at their other
+  // ends; see iopipestream::detach.
+  void detach() {
+    tex.detach();
+    for(texpool::iterator p=TeXpool.begin(); p != TeXpool.end(); ++p)
+      (*p)->detach();
+    TeXpool.clear();
+  }
+  
+  // Prepares for running the code again, closing the files it left open.  An
+  // idle TeX pipe is kept, and used again by texinit if the preamble of the
+  // next run starts with the one the pipe was given, unless a label changed
+  // its state.
+  void restart() {
+    if(!TeXkept) {
+      TeXkept=tex.isopen() && tex.running() && TeXpipepreamble.empty() &&
+        !TeXchanged;
+      if(TeXkept)
+        TeXpiped=TeXpreamble;
+      else
+        tex.pipeclose();
+    }
+    TeXchanged=false;
+    closepool();
+    TeXpipepreamble.clear();
+    TeXpreamble.clear();
+    atExitFunction=NULL;
+    atUpdateFunction=NULL;
+    atBreakpointFunction=NULL;
+    defaultpen=camp::pen::initialpen();
+    currentpen=camp::pen();
+    ofile.clear();
+    ifile.clear();
+#ifdef HAVE_RPC_RPC_H
+    ixfile.clear();
+    oxfile.clear();
+#endif
+  }
+
 };
 
 processDataStruct &processData();
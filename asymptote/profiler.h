@@ -13,13 +13,10 @@
 #include <iostream>
 
 #include "inst.h"
+#include "vm.h"
 
 namespace vm {
 
-#ifdef DEBUG_BLTIN
-string lookupBltin(bltin b);
-#endif
-
 inline position positionFromLambda(lambda *func) {
   if (func == 0)
     return position();
@@ -39,11 +36,7 @@ inline void printNameFromLambda(ostream& out, lambda *func) {
     return;
   }
   
-#ifdef DEBUG_FRAME
   string name = func->name;
-#else
-  string name = "";
-#endif
 
   // If unnamed, use the pointer address.
   if (name.empty())
@@ -56,11 +49,7 @@ inline void printNameFromLambda(ostream& out, lambda *func) {
 }
 
 inline void printNameFromBltin(ostream& out, bltin b) {
-#ifdef DEBUG_BLTIN
   string name = lookupBltin(b);
-#else
-  string name = "";
-#endif
 
   if (!name.empty())
     out << name << " ";
@@ -155,11 +144,7 @@ class profiler : public gc {
 
 
     void pydump(ostream& out) {
-#ifdef DEBUG_FRAME
       string name = func ? func->name : "<top level>";
-#else
-      string name = "";
-#endif
 
       out << "dict(\n"
            << "    name = '" << name << " " << func << "',\n"
@@ -26,16 +26,56 @@ static const char optypes[] = {
 #undef OPCODE
 };
 
+namespace {
+mem::vector<const bltinName *> bltinTables;
+}
+
+void registerBltinNames(const bltinName *table) {
+  for (size_t i = 0; i < bltinTables.size(); ++i)
+    if (bltinTables[i] == table)
+      return;
+  bltinTables.push_back(table);
+}
+
+namespace {
+mem::vector<const nativeEntry *> nativeTables;
+mem::map<bltin,const nativeEntry *> nativeRegistry;
+}
+
+void registerNatives(const nativeEntry *table) {
+  for (size_t i = 0; i < nativeTables.size(); ++i)
+    if (nativeTables[i] == table)
+      return;
+  nativeTables.push_back(table);
+  for (const nativeEntry *n = table; n->f; ++n)
+    nativeRegistry[n->f] = n;
+}
+
+const nativeEntry *lookupNative(bltin f) {
+  mem::map<bltin,const nativeEntry *>::iterator p = nativeRegistry.find(f);
+  return p != nativeRegistry.end() ? p->second : 0;
+}
+
 #ifdef DEBUG_BLTIN
 mem::map<bltin,string> bltinRegistry;
 
 void registerBltin(bltin b, string s) {
   bltinRegistry[b] = s;
 }
+#endif
+
 string lookupBltin(bltin b) {
-  return bltinRegistry[b];
-}
+#ifdef DEBUG_BLTIN
+  mem::map<bltin,string>::iterator p = bltinRegistry.find(b);
+  if (p != bltinRegistry.end())
+    return p->second;
 #endif
+  for (size_t i = 0; i < bltinTables.size(); ++i)
+    for (const bltinName *n = bltinTables[i]; n->f; ++n)
+      if (n->f == b)
+        return n->name;
+  return "";
+}
 
 
 ostream& operator<< (ostream& out, const item& i)
@@ -123,10 +163,23 @@ void printInst(ostream& out, const program::label& code,
 
     case 'b':
     {
-#ifdef DEBUG_BLTIN
       string s=lookupBltin(get<bltin>(*code));
       out << " " << (!s.empty() ? s : "<unnamed>") << " ";
-#endif
+      break;
+    }
+
+    case 'v':
+    {
+      string s=lookupBltin(get<const nativeEntry*>(*code)->f);
+      out << " " << (!s.empty() ? s : "<unnamed>") << " ";
+      break;
+    }
+
+    case 'a':
+    {
+      nativeCall *c=get<nativeCall*>(*code);
+      string s=lookupBltin(c->entry->f);
+      out << " " << (!s.empty() ? s : "<unnamed>") << " ";
       break;
     }
 
@@ -142,9 +195,7 @@ void printInst(ostream& out, const program::label& code,
 
     case 'l':
     {
-#ifdef DEBUG_FRAME
       out << " " << get<lambda*>(*code)->name << " ";
-#endif
       break;
     }
     
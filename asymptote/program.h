@@ -25,6 +25,9 @@ public:
   void encode(inst i);
   label begin();
   label end();
+  label at(size_t n);
+  size_t size() const;
+  void resize(size_t n);
   inst &back();
   void pop_back();
 private:
@@ -70,6 +73,12 @@ inline program::label program::end()
 { return label(code.size(), this); }
 inline program::label program::begin()
 { return label(0, this); }
+inline program::label program::at(size_t n)
+{ return label(n, this); }
+inline size_t program::size() const
+{ return code.size(); }
+inline void program::resize(size_t n)
+{ code.resize(n); }
 inline inst& program::back()
 { return code.back(); }
 inline void program::pop_back()
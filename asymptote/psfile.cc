@@ -52,6 +52,10 @@ psfile::psfile(const string& filename, bool pdfformat)
     reportError("Cannot write to "+filename);
 }
 
+psfile::psfile(std::ostream *out, const string& filename, bool pdfformat)
+  : filename(filename), pdfformat(pdfformat), pdf(true),
+    transparency(false), buffer(NULL), out(out) {}
+
 static const char *inconsistent="inconsistent colorspaces";
 static const char *rectangular="matrix is not rectangular";
   
@@ -356,6 +360,15 @@ void psfile::gradientshade(bool axial, ColorSpace colorspace,
   endclip(pena);
 
   setopacity(pena);
+  gradient(axial,colorspace,pena,a,ra,extenda,penb,b,rb,extendb);
+  *out << "shfill" << newl;
+}
+
+void psfile::gradient(bool axial, ColorSpace colorspace,
+                      const pen& pena, const pair& a, double ra,
+                      bool extenda, const pen& penb, const pair& b,
+                      double rb, bool extendb)
+{
   checkColorSpace(colorspace);
   
   *out << "<< /ShadingType " << (axial ? "2" : "3") << newl
@@ -378,8 +391,7 @@ void psfile::gradientshade(bool axial, ColorSpace colorspace,
   *out << "]" << newl
        << "/N 1" << newl
        << ">>" << newl
-       << ">>" << newl
-       << "shfill" << newl;
+       << ">>" << newl;
 }
   
 void psfile::gouraudshade(const pen& pentype,
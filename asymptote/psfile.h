@@ -94,6 +94,8 @@ public:
   }
 };
 
+void checkColorSpace(ColorSpace colorspace);
+
 class psfile {
 protected:  
   mem::stack<pen> pens;
@@ -120,8 +122,8 @@ public:
     count=0;
   }
   
-  void outImage(bool antialias, size_t width, size_t height,
-                size_t ncomponents);
+  virtual void outImage(bool antialias, size_t width, size_t height,
+                        size_t ncomponents);
   
   void endImage(bool antialias, size_t width, size_t height,
                 size_t ncomponents) {
@@ -137,6 +139,10 @@ protected:
   pen lastpen;
   std::ostream *out;
   
+  // Writes PDF operators to the stream out, which the caller owns and
+  // sets up.
+  psfile(std::ostream *out, const string& filename, bool pdfformat);
+  
 public: 
   psfile(const string& filename, bool pdfformat);
   
@@ -184,7 +190,7 @@ public:
   }
   
   void setcolor(const pen& p, const string& begin, const string& end);
-  void setopacity(const pen& p);
+  virtual void setopacity(const pen& p);
 
   virtual void setpen(pen p);
   
@@ -281,6 +287,12 @@ public:
                              bool extenda, const pen& penb, const pair& b,
                              double rb, bool extendb);
   
+  // The dictionary of an axial or radial shading.
+  void gradient(bool axial, ColorSpace colorspace,
+                const pen& pena, const pair& a, double ra,
+                bool extenda, const pen& penb, const pair& b,
+                double rb, bool extendb);
+  
   virtual void begingouraudshade(const vm::array& pens,
                                  const vm::array& vertices,
                                  const vm::array& edges) {}
@@ -295,7 +307,8 @@ public:
   
   void vertexpen(vm::array *pi, int j, ColorSpace colorspace);
   
-  void imageheader(size_t width, size_t height, ColorSpace colorspace);
+  virtual void imageheader(size_t width, size_t height,
+                           ColorSpace colorspace);
   
   void image(const vm::array& a, const vm::array& p, bool antialias);
   void image(const vm::array& a, bool antialias);
@@ -323,10 +336,10 @@ public:
 
   virtual void translate(pair z) {
     if(z == pair(0.0,0.0)) return;
-    if(pdf) *out << " 1 0 0 1 " << newl;
+    if(pdf) *out << " 1 0 0 1";
     write(z);
     if(pdf) *out << " cm" << newl;
-    *out << " translate" << newl;
+    else *out << " translate" << newl;
   }
 
   // Multiply on a transform to the transformation matrix.
@@ -337,11 +350,11 @@ public:
     else *out << " concat" << newl;
   }
   
-  void verbatimline(const string& s) {
+  virtual void verbatimline(const string& s) {
     *out << s << newl;
   }
   
-  void verbatim(const string& s) {
+  virtual void verbatim(const string& s) {
     *out << s;
   }
 
@@ -118,6 +118,32 @@ sub asy_params {
     return @params;
 }
 
+# The types of the virtual machine stored unboxed, which native entry points
+# take and return.
+my %native_types = map {$_ => 1} qw(Int real bool pair triple);
+
+# The asy array types of the native types, for elementwise functions.
+my %array_types = (Int => "types::IntArray()", real => "types::realArray()",
+                   bool => "types::booleanArray()",
+                   pair => "types::pairArray()",
+                   triple => "types::tripleArray()");
+
+# Named functions of one value that are not extended elementwise to arrays:
+# the length of an array reads as its number of elements.
+my %not_elementwise = map {$_ => 1} qw(length cast);
+
+# Returns the type and name of each parameter, up to the first that is not
+# a plain parameter of a native type.
+sub native_params {
+    my @native;
+    for (@_) {
+        last unless m/^\s*(?:explicit\s+)?(\w+)\s+(\w+)\s*$/s and
+            $native_types{$1};
+        push @native, [$1, $2];
+    }
+    return @native;
+}
+
 sub c_params {
    my @params = @_;
    for (@params) {
@@ -239,9 +265,42 @@ while (<>) {
       . ',"' . $cname . '"' . ");\n";
   }
 
+  # Name the function in profiles.
+  my $label = $name ? "$name($params)" : $cname;
+  $label =~ s/\s+/ /g;
+  $label =~ s/([\\"])/\\$1/g;
+  push @names, "  {run::$cname, \"$label\"},\n";
+
+  # A function of primitive values that does not use the stack itself also
+  # gets a native entry point, which the virtual machine calls with the
+  # arguments in place.
+  my @native_params = native_params(@params);
+  my $native = $native_types{$type} && @native_params == @params &&
+    @params > 0 && $code !~ /\b$stack\b/;
+  if ($native) {
+    push @natives, "  {run::$cname, run::${cname}_direct, " . @params . "},\n";
+  }
+
+  # A named function of one real, pair, or triple is also defined
+  # elementwise on arrays, as a loop over the array calling the function
+  # directly.
+  if ($native && @params == 1 && $name =~ /^\w+$/ &&
+      !$not_elementwise{$name} &&
+      $native_params[0][0] =~ /^(real|pair|triple)$/) {
+    my ($ptype, $pname) = @{$native_params[0]};
+    my $explicit = ($params[0] =~ /^\s*explicit\b/ ? "true" : "false");
+    push @builtin, "#line $source_line \"$prefix.in\"\n"
+      . "  addFunc(ve, run::arrayFunc<$type,$ptype,run::${cname}_native>, "
+      . "$array_types{$type}, " . symbolize($name)
+      . ", formal($array_types{$ptype}, " . symbolize(lc($pname))
+      . ", false, $explicit));\n";
+  }
+
   # Handle marshalling of values to/from stack
   $qualifier = ($type eq "item" ? "" : "<$type>");
-  $code =~ s/\breturn ([^;]*);/{$stack->push$qualifier($1); return;}/g;
+  if (not $native) {
+    $code =~ s/\breturn ([^;]*);/{$stack->push$qualifier($1); return;}/g;
+  }
   $args = join("",c_params(@params));
 
   print $comments;
@@ -255,11 +314,26 @@ while (<>) {
     clean_params($prototype);
     print "// $prototype\n";
   }
-  print "void $cname(stack *";
-  if($type ne "void" or $params ne "") {print $stack;}
-  print ")\n{\n$args";
-  print "#line $source_line \"$prefix.in\"";
-  print "$code}\n\n";
+  if ($native) {
+    my $formals = join(", ", map {"$$_[0] $$_[1]"} @native_params);
+    my $actuals = join(", ", map {$$_[1]} @native_params);
+    my $i = 0;
+    my $items = join(", ", map {"vm::get<$$_[0]>(args[" . $i++ . "])"}
+                     @native_params);
+    print "inline $type ${cname}_native($formals)\n{\n";
+    print "#line $source_line \"$prefix.in\"";
+    print "$code}\n\n";
+    print "void $cname(stack *$stack)\n{\n$args";
+    print "  $stack->push$qualifier(${cname}_native($actuals));\n}\n\n";
+    print "static void ${cname}_direct(vm::item *args)\n{\n";
+    print "  args[0]=${cname}_native($items);\n}\n\n";
+  } else {
+    print "void $cname(stack *";
+    if($type ne "void" or $params ne "") {print $stack;}
+    print ")\n{\n$args";
+    print "#line $source_line \"$prefix.in\"";
+    print "$code}\n\n";
+  }
   
   $source_line -= $ncomments+$nprototype;
   $source_line += ($_ =~ tr/\n//);
@@ -269,7 +343,15 @@ while (<>) {
 print "} // namespace run\n";
 
 print "\nnamespace trans {\n\n";
+print "static const vm::bltinName ${prefix}_names[] = {\n";
+print @names;
+print "  {0, 0}\n};\n\n";
+print "static const vm::nativeEntry ${prefix}_natives[] = {\n";
+print @natives;
+print "  {0, 0, 0}\n};\n\n";
 print "void gen_${prefix}_venv(venv &ve)\n{\n";
+print "  vm::registerBltinNames(${prefix}_names);\n";
+print "  vm::registerNatives(${prefix}_natives);\n";
 print @builtin;
 print "}\n\n";
 print "} // namespace trans\n";
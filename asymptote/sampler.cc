@@ -0,0 +1,357 @@
+/*****
+ * sampler.cc
+ *
+ * A sampling profiler for the virtual machine.
+ *****/
+
+#include <sys/time.h>
+#include <fstream>
+#include <zlib.h>
+
+#include "sampler.h"
+#include "program.h"
+#include "profiler.h"
+
+namespace vm {
+namespace sampler {
+
+bool active=false;
+volatile call calls[MAXDEPTH];
+volatile sig_atomic_t depth=0;
+
+namespace {
+
+// The signal handler cannot allocate memory, so the distinct stacks sampled
+// are counted in a hash table, and their calls stored in a pool, that are
+// both allocated in advance.  Samples that do not fit are lost.
+const size_t TABLESIZE=1 << 14;
+const size_t MAXPROBES=64;
+const size_t POOLSIZE=1 << 18;
+
+struct stackCount {
+  size_t start;
+  size_t length;
+  size_t count;
+};
+
+stackCount *table=0;
+call *pool=0;
+size_t poolUsed=0;
+size_t lost=0;
+
+Int period;
+struct timeval started;
+struct sigaction oldaction;
+
+size_t hash(size_t n)
+{
+  size_t h=2166136261U;
+  for(size_t i=0; i < n; ++i) {
+    h=(h ^ (size_t) calls[i].func)*16777619U;
+    h=(h ^ (size_t) calls[i].cfunc)*16777619U;
+  }
+  return h ^ n;
+}
+
+bool matches(const stackCount& s, size_t n)
+{
+  if(s.length != n)
+    return false;
+  for(size_t i=0; i < n; ++i) {
+    const call& c=pool[s.start+i];
+    if(c.func != calls[i].func || c.cfunc != calls[i].cfunc)
+      return false;
+  }
+  return true;
+}
+
+RETSIGTYPE sample(int)
+{
+  size_t n=depth < (sig_atomic_t) MAXDEPTH ? depth : MAXDEPTH;
+  size_t h=hash(n);
+  for(size_t i=0; i < MAXPROBES; ++i) {
+    stackCount& s=table[(h+i) & (TABLESIZE-1)];
+    if(s.count == 0) {
+      if(poolUsed+n > POOLSIZE)
+        break;
+      for(size_t j=0; j < n; ++j) {
+        pool[poolUsed+j].func=calls[j].func;
+        pool[poolUsed+j].cfunc=calls[j].cfunc;
+      }
+      s.start=poolUsed;
+      s.length=n;
+      s.count=1;
+      poolUsed += n;
+      return;
+    }
+    if(matches(s,n)) {
+      ++s.count;
+      return;
+    }
+  }
+  ++lost;
+}
+
+void setTimer(Int usec)
+{
+  struct itimerval timer;
+  timer.it_interval.tv_sec=timer.it_value.tv_sec=usec/1000000;
+  timer.it_interval.tv_usec=timer.it_value.tv_usec=usec % 1000000;
+  setitimer(ITIMER_PROF,&timer,0);
+}
+
+long long elapsed()
+{
+  struct timeval now;
+  gettimeofday(&now,0);
+  return 1000000000LL*(now.tv_sec-started.tv_sec)+
+    1000LL*(now.tv_usec-started.tv_usec);
+}
+
+// The functions appearing in the samples, numbered from 1 as in pprof.
+// The stack of an empty sample is shown as a single pseudo-function.
+class functions {
+  mem::map<lambda *,size_t> lambdas;
+  mem::map<bltin,size_t> bltins;
+public:
+  mem::vector<call> list;
+
+  functions() {
+    call none={0,0};
+    list.push_back(none);
+  }
+
+  size_t id(const call& c) {
+    size_t& n=c.func ? lambdas[c.func] : bltins[c.cfunc];
+    if(n == 0) {
+      list.push_back(c);
+      n=list.size();
+    }
+    return n;
+  }
+};
+
+string name(const call& c)
+{
+  if(c.func)
+    return c.func->name;
+  if(c.cfunc) {
+    string s=lookupBltin(c.cfunc);
+    if(!s.empty())
+      return s;
+    ostringstream buf;
+    buf << "builtin at " << (void *) c.cfunc;
+    return buf.str();
+  }
+  return "<outside the virtual machine>";
+}
+
+// The name of a call in a flame graph, which cannot contain semicolons.
+string frameName(const call& c)
+{
+  ostringstream buf;
+  buf << name(c);
+  if(c.func) {
+    buf << " at ";
+    positionFromLambda(c.func).printTerse(buf);
+  }
+  string s=buf.str();
+  for(size_t i=0; i < s.size(); ++i)
+    if(s[i] == ';') s[i]=',';
+  return s;
+}
+
+void writeFolded(const string& filename)
+{
+  std::ofstream out(filename.c_str());
+  for(size_t i=0; i < TABLESIZE; ++i) {
+    const stackCount& s=table[i];
+    if(s.count == 0) continue;
+    if(s.length == 0)
+      out << frameName(call());
+    for(size_t j=0; j < s.length; ++j)
+      out << (j > 0 ? ";" : "") << frameName(pool[s.start+j]);
+    out << " " << s.count << "\n";
+  }
+  if(!out)
+    cerr << "cannot write profile " << filename << endl;
+}
+
+// Encodes the messages of profile.proto in the protocol buffer format.
+class message {
+  string buf;
+public:
+  void varint(unsigned long long v) {
+    while(v >= 0x80) {
+      buf += (char) (v | 0x80);
+      v >>= 7;
+    }
+    buf += (char) v;
+  }
+  void integer(int field, unsigned long long v) {
+    varint(field << 3);
+    varint(v);
+  }
+  void bytes(int field, const string& s) {
+    varint((field << 3) | 2);
+    varint(s.size());
+    buf += s;
+  }
+  void add(int field, const message& m) {
+    bytes(field,m.buf);
+  }
+  const string& str() const {
+    return buf;
+  }
+};
+
+class strings {
+  mem::map<string,size_t> index;
+public:
+  mem::vector<string> list;
+
+  strings() {
+    index[""]=0;
+    list.push_back("");
+  }
+
+  size_t id(const string& s) {
+    mem::map<string,size_t>::iterator p=index.find(s);
+    if(p != index.end())
+      return p->second;
+    list.push_back(s);
+    return index[s]=list.size()-1;
+  }
+};
+
+message valueType(strings& s, const string& type, const string& unit)
+{
+  message m;
+  m.integer(1,s.id(type));
+  m.integer(2,s.id(unit));
+  return m;
+}
+
+void writeProfile(const string& filename)
+{
+  message profile;
+  strings s;
+  functions f;
+
+  profile.add(1,valueType(s,"samples","count"));
+  profile.add(1,valueType(s,"cpu","nanoseconds"));
+
+  for(size_t i=0; i < TABLESIZE; ++i) {
+    const stackCount& c=table[i];
+    if(c.count == 0) continue;
+
+    // Locations are listed from the innermost call.
+    message locations;
+    if(c.length == 0)
+      locations.varint(1);
+    for(size_t j=c.length; j > 0; --j)
+      locations.varint(f.id(pool[c.start+j-1]));
+
+    message values;
+    values.varint(c.count);
+    values.varint(c.count*period);
+
+    message sample;
+    sample.bytes(1,locations.str());
+    sample.bytes(2,values.str());
+    profile.add(2,sample);
+  }
+
+  // Each function has a single location.
+  for(size_t i=0; i < f.list.size(); ++i) {
+    const call& c=f.list[i];
+    position pos=c.func ? positionFromLambda(c.func) : nullPos;
+
+    message function;
+    function.integer(1,i+1);
+    function.integer(2,s.id(name(c)));
+    function.integer(3,s.id(name(c)));
+    function.integer(4,s.id(pos.filename()));
+    function.integer(5,pos.Line());
+
+    message line;
+    line.integer(1,i+1);
+    line.integer(2,pos.Line());
+
+    message location;
+    location.integer(1,i+1);
+    location.add(4,line);
+
+    profile.add(4,location);
+    profile.add(5,function);
+  }
+
+  size_t periodType=s.id("cpu"), nanoseconds=s.id("nanoseconds");
+  for(size_t i=0; i < s.list.size(); ++i)
+    profile.bytes(6,s.list[i]);
+
+  profile.integer(9,1000000000LL*started.tv_sec+1000LL*started.tv_usec);
+  profile.integer(10,elapsed());
+  message type;
+  type.integer(1,periodType);
+  type.integer(2,nanoseconds);
+  profile.add(11,type);
+  profile.integer(12,period);
+
+  gzFile out=gzopen(filename.c_str(),"wb");
+  const string& data=profile.str();
+  if(!out || gzwrite(out,data.data(),data.size()) != (int) data.size() ||
+     gzclose(out) != Z_OK)
+    cerr << "cannot write profile " << filename << endl;
+}
+
+} // private
+
+void start(Int rate)
+{
+  if(active || rate <= 0) return;
+
+  table=(stackCount *) calloc(TABLESIZE,sizeof(stackCount));
+  pool=(call *) malloc(POOLSIZE*sizeof(call));
+  if(!table || !pool) {
+    cerr << "cannot allocate memory for profile" << endl;
+    return;
+  }
+
+  period=1000000000/rate;
+  gettimeofday(&started,0);
+  depth=0;
+  active=true;
+
+  struct sigaction action;
+  action.sa_handler=sample;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags=SA_RESTART;
+  sigaction(SIGPROF,&action,&oldaction);
+
+  setTimer(period/1000 > 0 ? period/1000 : 1);
+}
+
+void stop(const string& prefix)
+{
+  if(!active) return;
+
+  setTimer(0);
+  sigaction(SIGPROF,&oldaction,0);
+  active=false;
+  depth=0;
+
+  writeFolded(prefix+".folded");
+  writeProfile(prefix+".pb.gz");
+  if(lost > 0)
+    cerr << "profile lost " << lost << " samples" << endl;
+
+  free(table);
+  free(pool);
+  table=0;
+  pool=0;
+  poolUsed=lost=0;
+}
+
+} // namespace sampler
+} // namespace vm
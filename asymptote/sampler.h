@@ -0,0 +1,84 @@
+/*****
+ * sampler.h
+ *
+ * A sampling profiler for the virtual machine.  A profiling timer interrupts
+ * asy at regular intervals of processor time and records the stack of
+ * asymptote functions and builtins being run.  Unlike the profiler in
+ * profiler.h, it needs no special build and hardly slows asy down.
+ *****/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <csignal>
+
+#include "inst.h"
+
+namespace vm {
+namespace sampler {
+
+// The functions being run, outermost first.  Calls nested more deeply than
+// MAXDEPTH are counted but not recorded.
+const size_t MAXDEPTH=256;
+
+struct call {
+  lambda *func;
+  bltin cfunc;
+};
+
+extern bool active;
+extern volatile call calls[MAXDEPTH];
+extern volatile sig_atomic_t depth;
+
+inline void enter(lambda *func)
+{
+  if(active) {
+    if((size_t) depth < MAXDEPTH) {
+      calls[depth].func=func;
+      calls[depth].cfunc=0;
+    }
+    ++depth;
+  }
+}
+
+inline void enter(bltin cfunc)
+{
+  if(active) {
+    if((size_t) depth < MAXDEPTH) {
+      calls[depth].func=0;
+      calls[depth].cfunc=cfunc;
+    }
+    ++depth;
+  }
+}
+
+inline void leave()
+{
+  if(active)
+    --depth;
+}
+
+// Records the call of an asymptote function for the length of a scope, and
+// restores the stack when the call is left by an exception.
+class scope {
+  sig_atomic_t saved;
+public:
+  scope(lambda *func) : saved(depth) {
+    enter(func);
+  }
+  ~scope() {
+    depth=saved;
+  }
+};
+
+// Starts sampling the given number of times per second of processor time.
+void start(Int rate);
+
+// Stops sampling and writes the profile to prefix.folded, as folded stacks
+// for flame graphs, and to prefix.pb.gz, in the format read by pprof.
+void stop(const string& prefix);
+
+} // namespace sampler
+} // namespace vm
+
+#endif
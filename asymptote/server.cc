@@ -0,0 +1,317 @@
+/*****
+ * server.cc
+ *
+ * The local socket protocol between asy -server and asy -connect.
+ *****/
+
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "settings.h"
+#include "util.h"
+
+namespace server {
+
+namespace {
+
+// Identifies the protocol; change it whenever the format of a job changes.
+const unsigned MAGIC=0x61737901;
+
+const size_t NFDS=3;
+
+struct header {
+  unsigned magic;
+  unsigned length;
+};
+
+const char *socketPath=0;
+
+RETSIGTYPE removeSocket(int sig)
+{
+  if(socketPath)
+    unlink(socketPath);
+  _exit(128+sig);
+}
+
+void error(const string& msg, const string& path)
+{
+  cerr << msg << " " << path << ": " << strerror(errno) << endl;
+}
+
+bool address(const string& path, sockaddr_un& addr)
+{
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family=AF_UNIX;
+  if(path.size() >= sizeof(addr.sun_path)) {
+    cerr << "socket name too long: " << path << endl;
+    return false;
+  }
+  strcpy(addr.sun_path,path.c_str());
+  return true;
+}
+
+bool writeAll(int fd, const char *buf, size_t n)
+{
+  while(n > 0) {
+    ssize_t m=write(fd,buf,n);
+    if(m < 0) {
+      if(errno == EINTR) continue;
+      return false;
+    }
+    buf += m;
+    n -= m;
+  }
+  return true;
+}
+
+bool readAll(int fd, char *buf, size_t n)
+{
+  while(n > 0) {
+    ssize_t m=read(fd,buf,n);
+    if(m < 0) {
+      if(errno == EINTR) continue;
+      return false;
+    }
+    if(m == 0) return false;
+    buf += m;
+    n -= m;
+  }
+  return true;
+}
+
+// The payload is a sequence of null-terminated strings: the directory, the
+// file index and the command line.
+string encode(const job& j)
+{
+  string s=j.dir;
+  s.push_back('\0');
+  s += String(j.file);
+  s.push_back('\0');
+  for(size_t i=0; i < j.args.size(); ++i) {
+    s += j.args[i];
+    s.push_back('\0');
+  }
+  return s;
+}
+
+bool decode(const string& s, job& j)
+{
+  mem::vector<string> fields;
+  size_t start=0;
+  for(size_t i=0; i < s.size(); ++i)
+    if(s[i] == '\0') {
+      fields.push_back(s.substr(start,i-start));
+      start=i+1;
+    }
+  if(start != s.size() || fields.size() < 3)
+    return false;
+
+  j.dir=fields[0];
+  j.file=atoi(fields[1].c_str());
+  j.args.assign(fields.begin()+2,fields.end());
+  return true;
+}
+
+bool sendJob(int fd, const job& j)
+{
+  string payload=encode(j);
+  header h;
+  h.magic=MAGIC;
+  h.length=payload.size();
+
+  // The standard streams travel with the header.
+  int fds[NFDS]={STDIN_FILENO,STDOUT_FILENO,STDERR_FILENO};
+  char control[CMSG_SPACE(sizeof(fds))];
+  memset(control,0,sizeof(control));
+
+  iovec iov;
+  iov.iov_base=&h;
+  iov.iov_len=sizeof(h);
+
+  msghdr msg;
+  memset(&msg,0,sizeof(msg));
+  msg.msg_iov=&iov;
+  msg.msg_iovlen=1;
+  msg.msg_control=control;
+  msg.msg_controllen=sizeof(control);
+
+  cmsghdr *c=CMSG_FIRSTHDR(&msg);
+  c->cmsg_level=SOL_SOCKET;
+  c->cmsg_type=SCM_RIGHTS;
+  c->cmsg_len=CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(c),fds,sizeof(fds));
+
+  ssize_t n;
+  do
+    n=sendmsg(fd,&msg,0);
+  while(n < 0 && errno == EINTR);
+
+  return n == (ssize_t) sizeof(h) &&
+    writeAll(fd,payload.data(),payload.size());
+}
+
+} // private
+
+int openServer(const string& path)
+{
+  sockaddr_un addr;
+  if(!address(path,addr))
+    return -1;
+
+  int fd=socket(AF_UNIX,SOCK_STREAM,0);
+  if(fd < 0) {
+    error("cannot create socket",path);
+    return -1;
+  }
+
+  // Remove a socket left behind by a server that was killed, but nothing
+  // else, nor the socket of a server still listening on it.
+  struct stat buf;
+  if(lstat(path.c_str(),&buf) == 0) {
+    int probe=S_ISSOCK(buf.st_mode) ? socket(AF_UNIX,SOCK_STREAM,0) : -1;
+    bool live=probe >= 0 && connect(probe,(sockaddr *) &addr,sizeof(addr)) == 0;
+    if(probe >= 0) close(probe);
+    if(!S_ISSOCK(buf.st_mode) || live) {
+      errno=live ? EADDRINUSE : ENOTSOCK;
+      error("cannot listen on",path);
+      close(fd);
+      return -1;
+    }
+    unlink(path.c_str());
+  }
+
+  mode_t mask=umask(077);
+  int rc=bind(fd,(sockaddr *) &addr,sizeof(addr));
+  umask(mask);
+
+  if(rc < 0 || listen(fd,SOMAXCONN) < 0) {
+    error("cannot listen on socket",path);
+    close(fd);
+    return -1;
+  }
+
+  socketPath=StrdupNoGC(path);
+  Signal(SIGINT,removeSocket);
+  Signal(SIGTERM,removeSocket);
+  Signal(SIGHUP,removeSocket);
+
+  // Children are never waited for.
+  Signal(SIGCHLD,SIG_IGN);
+
+  return fd;
+}
+
+int acceptClient(int fd)
+{
+  int client=accept(fd,NULL,NULL);
+  if(client < 0 && errno != EINTR)
+    error("cannot accept connection on socket",socketPath);
+  return client;
+}
+
+void forked()
+{
+  Signal(SIGINT,SIG_DFL);
+  Signal(SIGTERM,SIG_DFL);
+  Signal(SIGHUP,SIG_DFL);
+  Signal(SIGCHLD,SIG_DFL);
+}
+
+bool receiveJob(int fd, job& j)
+{
+  header h;
+  int fds[NFDS];
+  char control[CMSG_SPACE(sizeof(fds))];
+
+  iovec iov;
+  iov.iov_base=&h;
+  iov.iov_len=sizeof(h);
+
+  msghdr msg;
+  memset(&msg,0,sizeof(msg));
+  msg.msg_iov=&iov;
+  msg.msg_iovlen=1;
+  msg.msg_control=control;
+  msg.msg_controllen=sizeof(control);
+
+  ssize_t n;
+  do
+    n=recvmsg(fd,&msg,0);
+  while(n < 0 && errno == EINTR);
+
+  cmsghdr *c=CMSG_FIRSTHDR(&msg);
+  if(n != (ssize_t) sizeof(h) || c == NULL ||
+     c->cmsg_type != SCM_RIGHTS || c->cmsg_len != CMSG_LEN(sizeof(fds)))
+    return false;
+  memcpy(fds,CMSG_DATA(c),sizeof(fds));
+
+  for(size_t i=0; i < NFDS; ++i) {
+    dup2(fds[i],(int) i);
+    close(fds[i]);
+  }
+
+  if(h.magic != MAGIC) {
+    cerr << "client and server versions differ" << endl;
+    return false;
+  }
+
+  string payload(h.length,'\0');
+  if(!readAll(fd,&payload[0],h.length) || !decode(payload,j)) {
+    cerr << "malformed job" << endl;
+    return false;
+  }
+
+  if(chdir(j.dir.c_str()) != 0) {
+    error("cannot change to directory",j.dir);
+    return false;
+  }
+  return true;
+}
+
+void sendStatus(int fd, int status)
+{
+  writeAll(fd,(const char *) &status,sizeof(status));
+}
+
+int runClient(const string& path, int argc, char *argv[])
+{
+  sockaddr_un addr;
+  if(!address(path,addr))
+    return 1;
+
+  job j;
+  j.dir=getPath();
+  for(int i=0; i < argc; ++i)
+    j.args.push_back(argv[i]);
+
+  // Like asy itself, process each file in turn, or standard input.
+  int n=settings::numArgs();
+  int status=0;
+  for(Int file=(n == 0 ? -1 : 0); file < n; ++file) {
+    int fd=socket(AF_UNIX,SOCK_STREAM,0);
+    if(fd < 0 || connect(fd,(sockaddr *) &addr,sizeof(addr)) < 0) {
+      error("cannot connect to server at",path);
+      return 1;
+    }
+
+    // The position of the file on the command line is sent rather than its
+    // name, so that the server parses the same options as we did.
+    j.file=file;
+    int result;
+    if(!sendJob(fd,j) || !readAll(fd,(char *) &result,sizeof(result))) {
+      cerr << "server at " << path << " did not complete the job" << endl;
+      result=1;
+    }
+    close(fd);
+    if(result != 0) status=result;
+  }
+  return status;
+}
+
+} // namespace server
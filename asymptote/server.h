@@ -0,0 +1,51 @@
+/*****
+ * server.h
+ *
+ * The local socket protocol between asy -server and asy -connect.  A client
+ * sends one job per file: its working directory, its command line, the index
+ * of the file argument to process and, as ancillary data, its standard input,
+ * output and error.  The server forks a child that adopts these streams, so
+ * output and diagnostics reach the client directly, and the child answers
+ * with its exit status once the job is done.
+ *****/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "common.h"
+
+namespace server {
+
+struct job {
+  string dir;
+  mem::vector<string> args;
+  Int file; // Index of the file argument, or -1 for standard input.
+};
+
+// Create the socket and listen on it, returning its descriptor.  The socket
+// is only accessible to the current user and is removed when the server is
+// terminated by a signal.
+int openServer(const string& path);
+
+// Wait for the next client, returning the descriptor of the connection or
+// -1 on a (recoverable) failure.
+int acceptClient(int fd);
+
+// Called in the child forked to handle a connection: restore the default
+// signal handlers of the server.
+void forked();
+
+// Read a job from the connection, replace our standard streams by those of
+// the client and change to its working directory.
+bool receiveJob(int fd, job& j);
+
+// Report the exit status of the job to the client.
+void sendStatus(int fd, int status);
+
+// Run each file named on the command line (or standard input) as a job on
+// the server at path, returning the exit status for asy.
+int runClient(const string& path, int argc, char *argv[]);
+
+} // namespace server
+
+#endif
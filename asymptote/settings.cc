@@ -214,6 +214,11 @@ bool bw;
 bool rgb;
 bool cmyk;
   
+// Fold constants, call builtins through their native entry points and
+// optimize translated code (stored in a global variable so the translator
+// can test it cheaply).
+bool peephole=true;
+
 // Disable system calls.
 bool safe=true;
 // Enable writing to (or changing to) other directories
@@ -1112,6 +1117,10 @@ void initSettings() {
                             "3D labels always face viewer by default", true));
   addOption(new boolSetting("threads", 0,
                             "Use POSIX threads for 3D rendering", !msdos));
+  addOption(new IntSetting("framejobs", 0, "n",
+                           "Ship out up to n animation frames at once [0 for one per processor]",1));
+  addOption(new IntSetting("arraythreads", 0, "n",
+                           "Use n threads for math functions of large real arrays [0 for one per processor]",1));
   addOption(new boolSetting("fitscreen", 0,
                             "Fit rendered image to screen", true));
   addOption(new boolSetting("interactiveWrite", 0,
@@ -1142,6 +1151,12 @@ void initSettings() {
   addOption(new boolSetting("twice", 0,
                             "Run LaTeX twice (to resolve references)"));
   addOption(new boolSetting("inlinetex", 0, "Generate inline TeX code"));
+  addOption(new boolSetting("labelcache", 0,
+                            "Remember label sizes and outlines found by TeX across runs",
+                            false));
+  addOption(new IntSetting("texpipes", 0, "n",
+                           "Measure labels with up to n TeX processes (0=one per processor)",
+                           1));
   addOption(new boolSetting("embed", 0, "Embed rendered preview image", true));
   addOption(new boolSetting("auto3D", 0, "Automatically activate 3D scene",
                             true));
@@ -1156,6 +1171,9 @@ void initSettings() {
   addOption(new boolSetting("parseonly", 'p', "Parse file"));
   addOption(new boolSetting("translate", 's',
                             "Show translated virtual machine code"));
+  addOption(new boolrefSetting("peephole", 0,
+                               "Optimize translated virtual machine code",
+                               &peephole, true));
   addOption(new boolSetting("tabcompletion", 0,
                             "Interactive prompt auto-completion", true));
   addOption(new boolSetting("listvariables", 'l',
@@ -1205,6 +1223,28 @@ void initSettings() {
 
   addOption(new boolSetting("wait", 0,
                             "Wait for child processes to finish before exiting"));
+  addOption(new boolSetting("watch", 0,
+                            "Run file again whenever it changes"));
+  addOption(new stringSetting("server", 0, "socket",
+                              "Serve jobs sent to local socket by -connect",
+                              ""));
+  addOption(new stringSetting("connect", 0, "socket",
+                              "Run job on server listening on local socket",
+                              ""));
+  addOption(new stringSetting("profile", 0, "prefix",
+                              "Write sampled profile to prefix.folded and prefix.pb.gz",
+                              ""));
+  addOption(new IntSetting("profilerate", 0, "n",
+                           "Sample profile n times per second",1000));
+  addOption(new boolSetting("heapstats", 0,
+                            "Report memory used after loading each module",
+                            false));
+  addOption(new boolSetting("timings", 0,
+                            "Report time and resources used by each phase",
+                            false));
+  addOption(new stringSetting("timingsjson", 0, "file",
+                              "Write -timings report as JSON to file",
+                              ""));
   addOption(new IntSetting("inpipe", 0, "n","",-1));
   addOption(new IntSetting("outpipe", 0, "n","",-1));
   addOption(new boolSetting("exitonEOF", 0, "Exit interactive mode on EOF",
@@ -1225,6 +1265,9 @@ void initSettings() {
   addOption(new boolSetting("autorotate", 0,
                             "Enable automatic PDF page rotation",
                             false));
+  addOption(new boolSetting("directpdf", 0,
+                            "Write PDF files without labels directly, not with Ghostscript",
+                            false));
   addOption(new boolSetting("pdfreload", 0,
                             "Automatically reload document in pdfviewer",
                             false));
@@ -1580,14 +1623,19 @@ void doConfig(string file)
 }
 
 void setOptions(int argc, char *argv[])
+{
+  // Build settings module.
+  initSettings();
+  
+  reloadOptions(argc,argv);
+}
+
+void reloadOptions(int argc, char *argv[])
 {
   argv0=argv[0];
 
   cout.precision(DBL_DIG);
 
-  // Build settings module.
-  initSettings();
-  
   // Read command-line options initially to obtain config, dir, sysdir, verbose.
   getOptions(argc,argv);
   
@@ -53,6 +53,7 @@ extern string docdir;
 extern const string dirsep;
   
 extern bool safe;
+extern bool peephole;
   
 bool globalwrite();
 
@@ -60,6 +61,7 @@ extern const string suffix;
 extern const string guisuffix;
 extern const string standardprefix;
   
+extern string initdir;
 extern string historyname;
   
 void SetPageDimensions();
@@ -86,6 +88,11 @@ string outname();
 
 void setOptions(int argc, char *argv[]);
 
+// Reset the settings to their defaults and read them again from argv and the
+// configuration file, without rebuilding the settings module (which code that
+// has already been translated refers to).
+void reloadOptions(int argc, char *argv[]);
+
 // Access the arguments once options have been parsed.
 int numArgs();
 char *getArg(int n);
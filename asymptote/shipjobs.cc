@@ -0,0 +1,130 @@
+/*****
+ * shipjobs.cc
+ *
+ * Ships out pictures in child processes, so that the TeX, dvips and
+ * Ghostscript runs for the frames of an animation overlap.
+ *****/
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include "shipjobs.h"
+#include "process.h"
+#include "parallel.h"
+#include "settings.h"
+#include "timings.h"
+
+using settings::getSetting;
+
+namespace camp {
+
+namespace {
+
+struct job {
+  int pid;
+  string prefix;
+};
+
+// The running jobs, oldest first.
+mem::list<job> jobs;
+
+// The prefixes of the jobs that failed.
+mem::list<string> failed;
+
+void finish(const job& j)
+{
+  int status;
+  while(waitpid(j.pid,&status,0) == -1) {
+    if(errno != EINTR) {
+      status=-1;
+      break;
+    }
+  }
+  if(status != 0)
+    failed.push_back(j.prefix);
+}
+
+// Waits for the oldest job, which is usually the first to finish.
+void finishOldest()
+{
+  job j=jobs.front();
+  jobs.pop_front();
+  finish(j);
+}
+
+size_t maxJobs()
+{
+  Int n=getSetting<Int>("framejobs");
+  return n > 0 ? (size_t) n : parallel::processors();
+}
+
+} // private
+
+void shipoutJob(picture *pic, picture *preamble, const string& prefix,
+                const string& format, bool wait)
+{
+  pic->bounds();
+
+  size_t max=maxJobs();
+  while(!jobs.empty() && jobs.size() >= max)
+    finishOldest();
+
+  if(max <= 1) {
+    pic->shipout(preamble,prefix,format,0.0,wait,false);
+    return;
+  }
+
+  // Avoid writing buffered output twice.
+  cout.flush();
+  cerr.flush();
+  em.sync();
+
+  int pid=fork();
+  if(pid == 0) {
+#ifdef USEGC
+    // A collection could try to stop threads that do not exist in the child.
+    GC_disable();
+#endif
+    // A TeX pipe that is still needed is restarted by the child.
+    processData().detach();
+    int status=1;
+    try {
+      pic->shipout(preamble,prefix,format,0.0,wait,false);
+      status=0;
+    } catch(...) {
+    }
+    cout.flush();
+    em.sync();
+    _exit(status);
+  }
+
+  if(pid < 0) {
+    pic->shipout(preamble,prefix,format,0.0,wait,false);
+    return;
+  }
+
+  timings::spawned();
+  job j;
+  j.pid=pid;
+  j.prefix=prefix;
+  jobs.push_back(j);
+}
+
+void waitShipoutJobs()
+{
+  while(!jobs.empty())
+    finishOldest();
+
+  if(!failed.empty()) {
+    ostringstream buf;
+    buf << "shipout failed:";
+    for(mem::list<string>::iterator p=failed.begin(); p != failed.end(); ++p)
+      buf << " " << *p;
+    failed.clear();
+    reportError(buf);
+  }
+}
+
+} // namespace camp
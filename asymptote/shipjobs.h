@@ -0,0 +1,27 @@
+/*****
+ * shipjobs.h
+ *
+ * Ships out pictures in child processes, so that the TeX, dvips and
+ * Ghostscript runs for the frames of an animation overlap.
+ *****/
+
+#ifndef SHIPJOBS_H
+#define SHIPJOBS_H
+
+#include "picture.h"
+
+namespace camp {
+
+// Ships out a picture in a child process, after waiting until fewer than
+// the number of jobs set by -framejobs are running.  The bounds of the
+// picture, which may need the TeX pipe, are found first by the caller.
+void shipoutJob(picture *pic, picture *preamble, const string& prefix,
+                const string& format, bool wait);
+
+// Waits until every picture shipped out by shipoutJob is written, and
+// reports an error if any failed.
+void waitShipoutJobs();
+
+} // namespace camp
+
+#endif
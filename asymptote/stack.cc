@@ -16,6 +16,8 @@
 #include "runtime.h"
 
 #include "profiler.h"
+#include "sampler.h"
+#include "parallel.h"
 
 #ifdef DEBUG_STACK
 #include <iostream>
@@ -34,7 +36,13 @@ namespace vm {
 mem::list<bpinfo> bplist;
   
 namespace {
+// Each thread running asymptote code has a position of its own; zero is
+// nullPos.
+#ifdef HAVE_PTHREAD
+__thread position curPos;
+#else
 position curPos = nullPos;
+#endif
 const program::label nulllabel;
 }
 
@@ -152,6 +160,18 @@ void stack::marshall(size_t args, stack::vars_t vars)
 #endif
 }
 
+stack::vars_t stack::makeClosure(lambda *l, vars_t parent, size_t start)
+{
+  vars_t closure = BASEFRAME(l->closuresize, 0, parent, l->name);
+  for (size_t i = 0; i < l->escaping.size(); ++i)
+#if SIMPLE_FRAME
+    closure[i+1] = theStack[start + l->escaping[i]];
+#else
+    (*closure)[i+1] = theStack[start + l->escaping[i]];
+#endif
+  return closure;
+}
+
 #ifdef PROFILE
 
 #ifndef DEBUG_FRAME
@@ -175,6 +195,12 @@ void assessClosure(lambda *body) {
   if (body->closureReq != lambda::MAYBE_NEEDS_CLOSURE)
     return;
 
+  // The escaping variables of the function have their own closure record.
+  if (body->closuresize > 0) {
+    body->closureReq = lambda::DOESNT_NEED_CLOSURE;
+    return;
+  }
+
   for (program::label l = body->code->begin(); l != body->code->end(); ++l)
     if (l->op == inst::pushclosure ||
         l->op == inst::pushframe) {
@@ -203,7 +229,10 @@ void stack::run(func *f)
   cout << endl;
 #endif
 
-  runWithOrWithoutClosure(body, 0, f->closure);
+  {
+    sampler::scope call(body);
+    runWithOrWithoutClosure(body, 0, f->closure);
+  }
 
 #ifdef PROFILE
   prof.endFunction(body);
@@ -265,7 +294,35 @@ void stack::debug()
 }
 
 
+// The lean dispatch loop uses computed gotos (a GNU extension) where
+// available; otherwise both loops dispatch with a switch.
+#if defined(__GNUC__) && !defined(NO_COMPUTED_GOTO)
+#define COMPUTED_GOTO
+#endif
+
+// Tracing, breakpoints, and profiling need the instrumented loop, which
+// examines every instruction before it is run.
+inline bool instrumented()
+{
+#if defined(PROFILE) || defined(DEBUG_STACK)
+  return true;
+#else
+  return settings::verbose > 4 || !bplist.empty();
+#endif
+}
+
 void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
+{
+  if(errorstream::interrupt) throw interrupted();
+
+  if (instrumented())
+    execute<true>(l, vars, parent);
+  else
+    execute<false>(l, vars, parent);
+}
+
+template <bool traced>
+void stack::execute(lambda *l, vars_t vars, vars_t parent)
 {
   // The size of the frame (when running without closure).
   size_t frameSize = l->parentIndex;
@@ -288,6 +345,17 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
 
   size_t frameStart = 0;
 
+  // Whether the variables are kept on the stack, and where they start there.
+  // The loop frames pushed by the function hide them temporarily.
+  bool onStack = false;
+  size_t stackStart = 0;
+
+  // The closure record of a function that keeps its variables on the stack,
+  // allocated when it is first pushed.
+  vars_t closure = 0;
+#define CLOSURE (closure ? closure : \
+                 (closure = makeClosure(l, parent, stackStart)))
+
   // Set up the closure, if necessary.
   if (vars == 0)
   {
@@ -310,6 +378,8 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
 
       // Record where the parameters start on the stack.
       frameStart = theStack.size() - frameSize;
+      onStack = true;
+      stackStart = frameStart;
 
       // Add the parent's closure to the frame.
       push(parent);
@@ -334,154 +404,374 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
   /* start the new function */
   program::label ip = l->code->begin();
 
+#ifdef COMPUTED_GOTO
+  static void *dispatch[] = {
+#define OPCODE(name, type) &&op_##name,
+#include "opcodes.h"
+#undef OPCODE
+  };
+
+  // Each case of the switch is also the target of a computed goto.  The lean
+  // loop goes straight from one instruction to the next; the traced loop
+  // returns to the top of the loop for its checks.
+#  define OP(name) case inst::name: op_##name
+#  define DISPATCH { i = &*ip; goto *dispatch[i->op]; }
+#else
+#  define OP(name) case inst::name
+#  define DISPATCH continue
+#endif
+
+  // Go on to the next instruction.
+#define NEXT { ++ip; if (traced) continue; DISPATCH; }
+
+  // Go on after a jump.  The lean loop only checks for interrupts at jumps
+  // and calls.
+#define JUMP { if (traced) continue; \
+               if (errorstream::interrupt) throw interrupted(); \
+               DISPATCH; }
+
+  // The lean loop only records the position of instructions that can call
+  // out or report an error.
+#define SETPOS if (!traced) curPos = i->pos
+
   try {
     for (;;) {
-      const inst &i = *ip;
-      curPos = i.pos;
+      const inst *i = &*ip;
+
+      if (traced) {
+        curPos = i->pos;
       
 #ifdef PROFILE
-      prof.recordInstruction();
+        prof.recordInstruction();
 #endif
 
 #ifdef DEBUG_STACK
-      printInst(cout, ip, l->code->begin());
-      cout << "    (";
-			i.pos.printTerse(cout);
-			cout << ")\n";
+        draw(cerr);
+        vm::draw(cerr,vars);
+        cerr << "\n";
+
+        printInst(cout, ip, l->code->begin());
+        cout << "    (";
+        i->pos.printTerse(cout);
+        cout << ")\n";
 #endif
 
-      if(settings::verbose > 4) em.trace(curPos);
+        if(settings::verbose > 4) em.trace(curPos);
       
-      if(!bplist.empty()) debug();
+        if(!bplist.empty()) debug();
       
-      if(errorstream::interrupt) throw interrupted();
+        if(errorstream::interrupt) throw interrupted();
+      }
+
+#ifdef COMPUTED_GOTO
+      goto *dispatch[i->op];
+#endif
       
-      switch (i.op)
+      switch (i->op)
         {
-          case inst::varpush:
-            push(VAR(get<Int>(i)));
-            break;
+          OP(varpush):
+            push(VAR(get<Int>(*i)));
+            NEXT;
 
-          case inst::varsave:
-            VAR(get<Int>(i)) = top();
-            break;
+          OP(varsave):
+            VAR(get<Int>(*i)) = top();
+            NEXT;
         
 #ifdef COMBO
-          case inst::varpop:
-            VAR(get<Int>(i)) = pop();
-            break;
+          OP(varpop):
+            VAR(get<Int>(*i)) = pop();
+            NEXT;
 #endif
 
-          case inst::ret: {
-            if (vars == 0)
+          OP(ret): {
+            if (onStack)
               // Delete the frame from the stack.
               // TODO: Optimize for common cases.
-              theStack.erase(theStack.begin() + frameStart,
-                             theStack.begin() + frameStart + frameSize);
+              theStack.erase(theStack.begin() + stackStart,
+                             theStack.begin() + stackStart + frameSize);
             return;
           }
 
-          case inst::pushframe:
+          OP(pushframe):
           {
-            assert(vars);
-            Int size = get<Int>(i);
-            vars=make_pushframe(size, vars);
+            Int size = get<Int>(*i);
+            vars=make_pushframe(size, vars ? vars : CLOSURE);
+            frameStart = 0;
 
             SET_VARLINK;
 
-            break;
+            NEXT;
           }
 
-          case inst::popframe:
+          OP(popframe):
           {
             assert(vars);
             vars=get<frame *>(VAR(0));
 
+#ifndef SIMPLE_FRAME
+            if (onStack && vars == closure) {
+              // Back to the variables on the stack.
+              vars = 0;
+              varlink = &theStack;
+              frameStart = stackStart;
+              NEXT;
+            }
+#endif
             SET_VARLINK;
 
-            break;
+            NEXT;
           }
 
-          case inst::pushclosure:
-            assert(vars);
-            push(vars);
-            break; 
+          OP(pushclosure):
+            push(vars ? vars : CLOSURE);
+            NEXT; 
 
-          case inst::nop:
-            break;
+          // An escaping variable stays on the stack until the closure
+          // record is allocated.
+          OP(closurepush): {
+            Int n = get<Int>(*i);
+            push(closure ? FRAMEVAR(closure, n) : VAR(l->escaping[n-1]));
+            NEXT;
+          }
 
-          case inst::pop:
+          OP(closuresave): {
+            Int n = get<Int>(*i);
+            (closure ? FRAMEVAR(closure, n) : VAR(l->escaping[n-1])) = top();
+            NEXT;
+          }
+
+          OP(nop):
+            NEXT;
+
+          OP(pop):
             pop();
-            break;
+            NEXT;
         
-          case inst::intpush:
-          case inst::constpush:
-            push(i.ref);
-            break;
+          OP(intpush):
+          OP(constpush):
+            push(i->ref);
+            NEXT;
         
-          case inst::fieldpush: {
+          OP(fieldpush): {
+            SETPOS;
             vars_t frame = pop<vars_t>();
             if (!frame)
               error("dereference of null pointer");
-            push(FRAMEVAR(frame, get<Int>(i)));
-            break;
+            push(FRAMEVAR(frame, get<Int>(*i)));
+            NEXT;
           }
         
-          case inst::fieldsave: {
+          OP(fieldsave): {
+            SETPOS;
             vars_t frame = pop<vars_t>();
             if (!frame)
               error("dereference of null pointer");
-            FRAMEVAR(frame, get<Int>(i)) = top();
-            break;
+            FRAMEVAR(frame, get<Int>(*i)) = top();
+            NEXT;
           }
 
 #if COMBO
-          case inst::fieldpop: {
+          OP(fieldpop): {
 #error NOT REIMPLEMENTED
             vars_t frame = pop<vars_t>();
             if (!frame)
               error("dereference of null pointer");
-            FRAMEVAR(get<Int>(i)) = pop();
-            break;
+            FRAMEVAR(get<Int>(*i)) = pop();
+            NEXT;
           }
 #endif
         
         
-          case inst::builtin: {
-            bltin func = get<bltin>(i);
+          OP(builtin): {
+            SETPOS;
+            bltin func = get<bltin>(*i);
 #ifdef PROFILE
             prof.beginFunction(func);
 #endif
+            sampler::enter(func);
             func(this);
+            sampler::leave();
 #ifdef PROFILE
             prof.endFunction(func);
 #endif
-            break;
+            NEXT;
+          }
+
+          OP(varpush_builtin): {
+            push(VAR(get<Int>(*i)));
+            ++ip;
+            curPos = ip->pos;
+            bltin func = get<bltin>(*ip);
+#ifdef PROFILE
+            prof.beginFunction(func);
+#endif
+            sampler::enter(func);
+            func(this);
+            sampler::leave();
+#ifdef PROFILE
+            prof.endFunction(func);
+#endif
+            NEXT;
           }
 
-          case inst::jmp:
-            ip = get<program::label>(i);
-            continue;
+          OP(constpush_builtin): {
+            push(i->ref);
+            ++ip;
+            curPos = ip->pos;
+            bltin func = get<bltin>(*ip);
+#ifdef PROFILE
+            prof.beginFunction(func);
+#endif
+            sampler::enter(func);
+            func(this);
+            sampler::leave();
+#ifdef PROFILE
+            prof.endFunction(func);
+#endif
+            NEXT;
+          }
 
-          case inst::cjmp:
-            if (pop<bool>()) { ip = get<program::label>(i); continue; }
-            break;
+          OP(native): {
+            SETPOS;
+            const nativeEntry *n = get<const nativeEntry *>(*i);
+#ifdef PROFILE
+            prof.beginFunction(n->f);
+#endif
+            sampler::enter(n->f);
+            callNative(n);
+            sampler::leave();
+#ifdef PROFILE
+            prof.endFunction(n->f);
+#endif
+            NEXT;
+          }
 
-          case inst::njmp:
-            if (!pop<bool>()) { ip = get<program::label>(i); continue; }
-            break;
+          OP(varpush_native): {
+            push(VAR(get<Int>(*i)));
+            ++ip;
+            curPos = ip->pos;
+            const nativeEntry *n = get<const nativeEntry *>(*ip);
+#ifdef PROFILE
+            prof.beginFunction(n->f);
+#endif
+            sampler::enter(n->f);
+            callNative(n);
+            sampler::leave();
+#ifdef PROFILE
+            prof.endFunction(n->f);
+#endif
+            NEXT;
+          }
 
-          case inst::jump_if_not_default:
-            if (!isdefault(pop())) { ip = get<program::label>(i); continue; }
-            break;
+          OP(constpush_native): {
+            push(i->ref);
+            ++ip;
+            curPos = ip->pos;
+            const nativeEntry *n = get<const nativeEntry *>(*ip);
+#ifdef PROFILE
+            prof.beginFunction(n->f);
+#endif
+            sampler::enter(n->f);
+            callNative(n);
+            sampler::leave();
+#ifdef PROFILE
+            prof.endFunction(n->f);
+#endif
+            NEXT;
+          }
+
+          OP(native_args): {
+            const nativeCall *c = get<nativeCall *>(*i);
+            const nativeEntry *n = c->entry;
+            item args[nativeCall::MAXARGS];
+            for (size_t k = 0; k < n->arity; ++k) {
+              args[k] = c->var[k] >= 0 ? VAR(c->var[k]) : c->value[k];
+              ++ip;
+            }
+            curPos = ip->pos;
+#ifdef PROFILE
+            prof.beginFunction(n->f);
+#endif
+            sampler::enter(n->f);
+            n->direct(args);
+            sampler::leave();
+#ifdef PROFILE
+            prof.endFunction(n->f);
+#endif
+            push(args[0]);
+            NEXT;
+          }
+
+          OP(varpush_fieldpush): {
+            item link = VAR(get<Int>(*i));
+            ++ip;
+            curPos = ip->pos;
+            vars_t frame = get<vars_t>(link);
+            if (!frame)
+              error("dereference of null pointer");
+            push(FRAMEVAR(frame, get<Int>(*ip)));
+            NEXT;
+          }
+
+          OP(varsave_pop):
+            VAR(get<Int>(*i)) = pop();
+            ++ip;
+            NEXT;
+
+          OP(fieldsave_pop): {
+            SETPOS;
+            vars_t frame = pop<vars_t>();
+            if (!frame)
+              error("dereference of null pointer");
+            FRAMEVAR(frame, get<Int>(*i)) = pop();
+            ++ip;
+            NEXT;
+          }
+
+          OP(builtin_cjmp):
+          OP(builtin_njmp): {
+            SETPOS;
+            bltin func = get<bltin>(*i);
+#ifdef PROFILE
+            prof.beginFunction(func);
+#endif
+            sampler::enter(func);
+            func(this);
+            sampler::leave();
+#ifdef PROFILE
+            prof.endFunction(func);
+#endif
+            bool cond = (i->op == inst::builtin_cjmp);
+            ++ip;
+            if (pop<bool>() == cond) { ip = get<program::label>(*ip); JUMP; }
+            NEXT;
+          }
+
+          OP(jmp):
+            ip = get<program::label>(*i);
+            JUMP;
+
+          OP(cjmp):
+            SETPOS;
+            if (pop<bool>()) { ip = get<program::label>(*i); JUMP; }
+            NEXT;
+
+          OP(njmp):
+            SETPOS;
+            if (!pop<bool>()) { ip = get<program::label>(*i); JUMP; }
+            NEXT;
+
+          OP(jump_if_not_default):
+            if (!isdefault(pop())) { ip = get<program::label>(*i); JUMP; }
+            NEXT;
 
 #ifdef COMBO
-          case inst::gejmp: {
+          OP(gejmp): {
             Int y = pop<Int>();
             Int x = pop<Int>();
             if (x>=y)
-              { ip = get<program::label>(i); continue; }
-            break;
+              { ip = get<program::label>(*i); JUMP; }
+            NEXT;
           }
 
 #if 0
@@ -489,7 +779,7 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
             callable * b=pop<callable *>();
             callable * a=pop<callable *>();
             if (a->compare(b))
-              { ip = get<program::label>(i); continue; }
+              { ip = get<program::label>(*i); continue; }
             break;
           }
 
@@ -497,43 +787,37 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
             callable * b=pop<callable *>();
             callable * a=pop<callable *>();
             if (!a->compare(b))
-              { ip = get<program::label>(i); continue; }
+              { ip = get<program::label>(*i); continue; }
             break;
           }
 #endif
 #endif
 
-          case inst::push_default:
+          OP(push_default):
             push(Default);
-            break;
+            NEXT;
 
-          case inst::popcall: {
+          OP(popcall): {
+            SETPOS;
             /* get the function reference off of the stack */
             callable* f = pop<callable*>();
             f->call(this);
-            break;
+            NEXT;
           }
 
-          case inst::makefunc: {
+          OP(makefunc): {
+            SETPOS;
             func *f = new func;
             f->closure = pop<vars_t>();
-            f->body = get<lambda*>(i);
+            f->body = get<lambda*>(*i);
 
             push((callable*)f);
-            break;
+            NEXT;
           }
         
           default:
             error("Internal VM error: Bad stack operand");
         }
-
-#ifdef DEBUG_STACK
-      draw(cerr);
-      vm::draw(cerr,vars);
-      cerr << "\n";
-#endif
-            
-      ++ip;
     }
   } catch (bad_item_value&) {
     error("Trying to use uninitialized value.");
@@ -542,9 +826,17 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
 #undef SET_VARLINK
 #undef VAR
 #undef FRAMEVAR
+#undef CLOSURE
+#undef OP
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef SETPOS
 }
 
 void stack::load(string index) {
+  // Modules are initialized once, by the stack of the main thread.
+  parallel::serial();
   frame *inst=instMap[index];
   if (inst)
     push(inst);
@@ -661,6 +953,7 @@ void interactiveStack::run(lambda *codelet) {
     resize_frame(globals, globals_size, codelet->framesize);
     globals_size = codelet->framesize;
   }
+  sampler::scope call(codelet);
   stack::runWithOrWithoutClosure(codelet, globals, 0);
 }
 
@@ -78,6 +78,16 @@ private:
   // Move arguments from stack to frame.
   void marshall(size_t args, stack::vars_t vars);
 
+  // Allocates the closure record of a function that keeps its variables on
+  // the stack, starting at the given position.
+  vars_t makeClosure(lambda *l, vars_t parent, size_t start);
+
+  // The dispatch loop for runWithOrWithoutClosure.  The traced version
+  // records the position of every instruction and checks it for breakpoints,
+  // tracing, and interrupts; the lean version does not.
+  template <bool traced>
+  void execute(lambda *l, vars_t vars, vars_t parent);
+
 public:
   stack() : e(0), debugOp(0), lastPos(nullPos),
             breakPos(nullPos), newline(false) {};
@@ -129,7 +139,17 @@ public:
   template <typename T>
   T pop()
   {
-    return get<T>(pop());
+    T ret = get<T>(theStack.back());
+    theStack.pop_back();
+    return ret;
+  }
+
+  // Calls a native entry point on the arguments on top of the stack, which
+  // are replaced by the result.
+  void callNative(const nativeEntry *n) {
+    n->direct(&theStack.back() + 1 - n->arity);
+    for (size_t k = n->arity; k > 1; --k)
+      theStack.pop_back();
   }
 };
 
@@ -141,7 +161,7 @@ inline item pop(stack* s)
 template <typename T>
 inline T pop(stack* s)
 {
-  return get<T>(pop(s));
+  return s->pop<T>();
 }
   
 template <typename T>
@@ -85,28 +85,18 @@ void initTable() {
   }
 }
 
-// Hashing constants found experimentally to reduce collision (a little).
-const uint A = 25191, B = 16342, C = 1746, D = 18326;
-
-// Hash the string into an integer.  Experimental testing has shown that
-// hashing only the first few letters seems to be faster than hashing deeper
-// into the string, even though this approach causes more hash collisions.
+// Hash the string into an integer, using the FNV-1a hash of every character.
+// Hashing only the first few characters is cheaper, but identifiers in the
+// base modules often share a long prefix (defaultpen, defaultfilename, ...),
+// and the probing needed to resolve the collisions costs more than the
+// extra characters hashed.  The symbols themselves are hashed again by
+// the environments, so the hash should also be spread over every bit.
 uint hash(const char *s, size_t len)
 {
-  uint h = s[0];
-  if (len == 2)
-    return h;
-  h += A*s[1];
-  if (len == 3)
-    return h;
-  h += B*s[2];
-  if (len == 4)
-    return h;
-  h += C*s[3];
-  if (len == 5)
-    return h;
-  h += D*s[4];
-  return h+len;
+  uint h=2166136261U;
+  for (const char *end=s+len-1; s != end; ++s)
+    h=(h ^ (unsigned char) *s)*16777619U;
+  return h;
 }
 
 /* Under normal circumstances, the initial table should be large enough for
@@ -149,7 +139,7 @@ void resizeTable() {
     // old hash table may not appear in the same spot in the new hash table.
     // Put "SKIP" entries in their place, so that the symbol will still be
     // found.
-    for (uint h = hash(r.s, strlen(r.s)+1); h < r.hashplus; ++h) {
+    for (uint h = hash(r.s, strlen(r.s)+1); h != r.hashplus; ++h) {
       symbolRecord &skipr = recordByHashplus(h);
       if (skipr.flag == 0)
         skipr.flag = SKIP;
@@ -262,8 +252,13 @@ symbol advancedInsert(const char *s, size_t len)
 
 symbol symbol::gensym(string s) {
   // Gensym can be inserted as if it were a normal string not already in the
-  // table.  advancedInsert handles this.
-  s = "gensym " + s;
+  // table.  advancedInsert handles this.  The strings are numbered so that
+  // they hash to different places; otherwise each gensym would have to probe
+  // past all of the earlier ones of the same name.
+  static size_t count = 0;
+  ostringstream buf;
+  buf << "gensym " << s << " " << ++count;
+  s = buf.str();
   return advancedInsert(s.c_str(), s.size() + 1);
 }
 
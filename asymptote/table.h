@@ -16,26 +16,47 @@
 
 namespace sym {
 
+// Hashes symbols for the hash tables of the environments.
+struct symbolHash {
+  size_t operator()(const symbol name) const {
+    return name.hash();
+  }
+};
+struct symbolEq {
+  bool operator()(const symbol s, const symbol t) const {
+    return s==t;
+  }
+};
+
 template <class B>
 class table;
 
 template <class B>
 std::ostream& operator<< (std::ostream& out, const table<B>& t);
 
+// A single hash table holds the bindings of all scopes.  Each name has a
+// bucket of its bindings, the innermost last, and a scope is undone by
+// popping the names entered since it began.  This replaces a map of lists
+// and a multimap for each scope, which allocated a node for every binding.
 template <class B>
 class table {
 protected:
-  typedef mem::multimap<symbol CONST,B> scope_t;
-  typedef typename scope_t::iterator scope_iterator;
-  typedef mem::list<scope_t> scopes_t;
-  typedef mem::list<B> name_t;
+  typedef mem::vector<B> name_t;
   typedef typename name_t::iterator name_iterator;
+#ifdef NOHASH
   typedef mem::map<symbol CONST,name_t> names_t;
+#else
+  typedef mem::unordered_map<symbol,name_t,symbolHash,symbolEq> names_t;
+#endif
   typedef typename names_t::iterator names_iterator;
 
-  scopes_t scopes;
   names_t names;
 
+  // The names entered, in order, and the number that had been entered when
+  // each scope began.
+  mem::vector<symbol> additions;
+  mem::vector<size_t> scopesizes;
+
   void remove(symbol key);
 public :
   table();
@@ -66,47 +87,50 @@ inline table<B>::table()
 template <class B>
 inline void table<B>::enter(symbol key, B value)
 {
-  scopes.front().insert(std::make_pair(key,value));
-  names[key].push_front(value);
+  additions.push_back(key);
+  names[key].push_back(value);
 }
 
 template <class B>
 inline B table<B>::look(symbol key)
 {
-  if (!names[key].empty())
-    return names[key].front();
+  names_iterator p = names.find(key);
+  if (p != names.end() && !p->second.empty())
+    return p->second.back();
   return 0;
 }
 
 template <class B>
 inline void table<B>::beginScope()
 {
-  scopes.push_front(scope_t());
+  scopesizes.push_back(additions.size());
 }
 
 template <class B>
 inline void table<B>::remove(symbol key)
 {
-  if (!names[key].empty())
-    names[key].pop_front();
+  name_t &list = names[key];
+  if (!list.empty())
+    list.pop_back();
 }
 
 template <class B>
 inline void table<B>::endScope()
 {
-  scope_t &scope = scopes.front();
-  for (scope_iterator p = scope.begin(); p != scope.end(); ++p)
-    remove(p->first);
-  scopes.pop_front();
+  size_t scopesize = scopesizes.back();
+  while (additions.size() > scopesize) {
+    remove(additions.back());
+    additions.pop_back();
+  }
+  scopesizes.pop_back();
 }
 
 template <class B>
 inline void table<B>::collapseScope()
 {
-  scope_t scope = scopes.front();
-  scopes.pop_front();
-
-  scopes.front().insert(scope.begin(), scope.end());
+  // As scopes are stored solely by the number of names entered before they
+  // began, dropping the top size puts its names into the scope below.
+  scopesizes.pop_back();
 }
 
 // Returns true if start is a prefix for name; eg, mac is a prefix of machine.
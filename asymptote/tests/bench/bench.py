@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+# Runs the benchmarks in this directory and reports for each the elapsed
+# and processor time, the instructions executed, the bytes allocated, the
+# largest resident set size, and the size of the files written.  Results
+# can be saved, and compared with those of an earlier build:
+#
+#   ./bench.py -save before.json
+#   (rebuild asy)
+#   ./bench.py -compare before.json
+#
+# Each benchmark is run -n times in a scratch directory, with an empty
+# configuration directory, and the fastest run is reported.  The other
+# figures come from the -timingsjson report of asy, except the
+# instructions, which are counted by perf when it is installed.  Bytes
+# allocated are known only to a build with the garbage collector.
+# Benchmarks that fail, such as those needing latex when it is not
+# installed, are reported and left out of the comparison.  With -compare,
+# the exit status is 1 if any figure grew by more than the -threshold
+# percentage.
+
+import argparse
+import glob
+import json
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+here = os.path.dirname(os.path.abspath(__file__))
+
+# The figures reported, the key of each, and whether it is compared.
+columns = [("wall(s)", "wall", True),
+           ("cpu(s)", "cpu", False),
+           ("instructions", "instructions", True),
+           ("allocated", "allocated", True),
+           ("maxrss", "maxrss", True),
+           ("output", "output", True)]
+
+def which(program):
+    for d in os.environ.get("PATH", "").split(os.pathsep):
+        path = os.path.join(d, program)
+        if os.path.isfile(path) and os.access(path, os.X_OK):
+            return path
+    return None
+
+def outputSize(directory, exclude):
+    size = 0
+    for name in os.listdir(directory):
+        if name not in exclude:
+            size += os.path.getsize(os.path.join(directory, name))
+    return size
+
+def instructions(filename):
+    # perf -x writes comma-separated lines of count,unit,event,...
+    try:
+        for line in open(filename):
+            fields = line.split(",")
+            if len(fields) > 2 and fields[2].startswith("instructions"):
+                return int(fields[0])
+    except (IOError, ValueError):
+        pass
+    return None
+
+def runOnce(args, bench, perf):
+    scratch = tempfile.mkdtemp(prefix="asybench")
+    # An empty configuration directory of its own keeps each run from
+    # reading the user's configuration and from finding labels measured by
+    # an earlier run in the label cache.
+    home = tempfile.mkdtemp(prefix="asyhome")
+    environment = dict(os.environ, ASYMPTOTE_HOME=home)
+    try:
+        name = os.path.splitext(os.path.basename(bench))[0]
+        report = os.path.join(scratch, "timings.json")
+        counts = os.path.join(scratch, "perf.txt")
+        command = [args.asy, "-dir", args.dir, "-noV", "-timingsjson", report,
+                   "-o", name, bench]
+        if perf:
+            command = [perf, "stat", "-x,", "-e", "instructions:u",
+                       "-o", counts, "--"] + command
+        start = time.time()
+        with open(os.devnull) as devnull:
+            # asy runs in a process group of its own, so that the group,
+            # with any latex or child shipping out frames, can be stopped
+            # without stopping this script.
+            process = subprocess.Popen(command, cwd=scratch, stdin=devnull,
+                                       stdout=subprocess.PIPE,
+                                       stderr=subprocess.STDOUT,
+                                       env=environment,
+                                       preexec_fn=os.setsid)
+            timer = threading.Timer(args.timeout, os.killpg,
+                                    [process.pid, signal.SIGKILL])
+            timer.start()
+            messages = process.communicate()[0]
+            timer.cancel()
+        wall = time.time() - start
+        if wall >= args.timeout:
+            return {"failed": "timed out"}
+        if process.returncode != 0 or not os.path.exists(report):
+            lines = messages.decode("utf-8", "replace").splitlines()
+            return {"failed": lines[0] if lines else
+                    "exit status %d" % process.returncode}
+        timings = json.load(open(report))
+        total = timings["total"]
+        return {"wall": wall,
+                "cpu": total["cpu"] + total["childcpu"],
+                "instructions": instructions(counts) if perf else None,
+                "allocated": timings.get("allocated") or None,
+                "maxrss": timings["maxrss"],
+                "output": outputSize(scratch, ["timings.json", "perf.txt"])}
+    finally:
+        shutil.rmtree(scratch, True)
+        shutil.rmtree(home, True)
+
+def run(args, bench, perf):
+    best = None
+    for i in range(args.n):
+        result = runOnce(args, bench, perf)
+        if "failed" in result:
+            return result
+        if best is None or result["wall"] < best["wall"]:
+            best = result
+    return best
+
+def figure(key, value):
+    if value is None:
+        return "-"
+    if key in ("wall", "cpu"):
+        return "%.3f" % value
+    if key in ("allocated", "maxrss", "output") and value >= 1048576:
+        return "%.1fM" % (value / 1048576.0)
+    return str(value)
+
+def change(key, value, before, threshold):
+    # Returns the text of a figure with its change, and whether it regressed.
+    text = figure(key, value)
+    if value is None or not before or before.get(key) is None or \
+       before[key] == 0:
+        return text, False
+    percent = 100.0 * (value - before[key]) / before[key]
+    regressed = percent > threshold
+    return "%s %+.0f%%%s" % (text, percent, "!" if regressed else ""), \
+        regressed
+
+def main():
+    parser = argparse.ArgumentParser(
+        prefix_chars="-",
+        description="Run the asy benchmarks in " + here + ".")
+    parser.add_argument("-asy", default=os.path.join(here, "..", "..", "asy"),
+                        help="asy to run (default ../../asy)")
+    parser.add_argument("-dir", default=None,
+                        help="base directory (default base next to asy)")
+    parser.add_argument("-n", type=int, default=3,
+                        help="runs of each benchmark (default 3)")
+    parser.add_argument("-save", metavar="FILE",
+                        help="save the results as JSON")
+    parser.add_argument("-compare", metavar="FILE",
+                        help="compare with results saved earlier")
+    parser.add_argument("-threshold", type=float, default=10,
+                        help="percentage growth reported as a regression "
+                        "(default 10)")
+    parser.add_argument("-timeout", type=float, default=300,
+                        help="seconds before a run is stopped (default 300)")
+    parser.add_argument("-noperf", action="store_true",
+                        help="do not count instructions with perf")
+    parser.add_argument("benchmarks", nargs="*",
+                        help="benchmarks to run (default all)")
+    args = parser.parse_args()
+
+    args.asy = os.path.abspath(args.asy)
+    if args.dir is None:
+        args.dir = os.path.join(os.path.dirname(args.asy), "base")
+    args.dir = os.path.abspath(args.dir)
+    benchmarks = args.benchmarks or sorted(glob.glob(os.path.join(here,
+                                                                  "*.asy")))
+    benchmarks = [os.path.abspath(b) for b in benchmarks]
+    perf = None if args.noperf else which("perf")
+    baseline = json.load(open(args.compare)) if args.compare else {}
+
+    width = max(len(os.path.basename(b)) for b in benchmarks) + 2
+    print("%-*s" % (width, "benchmark") +
+          "".join("%18s" % c[0] for c in columns))
+    results = {}
+    regressions = []
+    for bench in benchmarks:
+        name = os.path.splitext(os.path.basename(bench))[0]
+        result = run(args, bench, perf)
+        results[name] = result
+        line = "%-*s" % (width, name)
+        if "failed" in result:
+            print(line + "failed: " + result["failed"])
+            continue
+        before = baseline.get(name)
+        if before and "failed" in before:
+            before = None
+        for title, key, compared in columns:
+            if compared:
+                text, regressed = change(key, result[key], before,
+                                         args.threshold)
+                if regressed:
+                    regressions.append(name + " " + title)
+            else:
+                text = figure(key, result[key])
+            line += "%18s" % text
+        print(line)
+        sys.stdout.flush()
+
+    if args.save:
+        with open(args.save, "w") as out:
+            json.dump(results, out, indent=2, sort_keys=True)
+            out.write("\n")
+    if regressions:
+        print("regressions: " + ", ".join(regressions))
+        return 1
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -121,17 +121,6 @@ void texdefines(T& out, mem::list<string>& preamble=processData().TeXpreamble,
   if(pipe || !settings::getSetting<bool>("inlinetex"))
     texpreamble(out,preamble,!pipe);
 
-  if(pipe) {
-    // Make tex pipe aware of a previously generated aux file.
-    string name=auxname(settings::outname(),"aux");
-    std::ifstream fin(name.c_str());
-    if(fin) {
-      std::ofstream fout("texput.aux");
-      string s;
-      while(getline(fin,s))
-        fout << s << endl;
-    }
-  }
   string texengine=settings::getSetting<string>("tex");
   if(settings::latex(texengine)) {
     if(pipe || !settings::getSetting<bool>("inlinetex")) {
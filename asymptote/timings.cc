@@ -0,0 +1,234 @@
+/*****
+ * timings.cc
+ *
+ * Accounts for the time and resources used by each phase of a run.
+ *****/
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+#include "timings.h"
+#include "settings.h"
+
+namespace timings {
+
+bool active=false;
+
+namespace {
+
+const char *names[NPHASES]={"other","parse","translate","run","labels",
+                            "shipout","latex","dvips","dvisvgm","gs",
+                            "convert","view"};
+
+struct usage {
+  double wall;
+  double cpu;
+  double childcpu;
+  size_t collections;
+};
+
+struct account {
+  size_t calls;
+  double wall;
+  double cpu;
+  double childcpu;
+  size_t processes;
+  size_t written;
+  size_t collections;
+};
+
+account accounts[NPHASES];
+phaseId current=OTHER;
+std::vector<phaseId> outer;
+usage last;
+size_t peakheap=0;
+size_t allocated=0;
+
+double seconds(const struct timeval& t)
+{
+  return t.tv_sec+1.0e-6*t.tv_usec;
+}
+
+double cputime(int who)
+{
+  struct rusage r;
+  if(getrusage(who,&r) != 0) return 0.0;
+  return seconds(r.ru_utime)+seconds(r.ru_stime);
+}
+
+usage now()
+{
+  usage u;
+  struct timeval t;
+  gettimeofday(&t,0);
+  u.wall=seconds(t);
+  u.cpu=cputime(RUSAGE_SELF);
+  u.childcpu=cputime(RUSAGE_CHILDREN);
+#ifdef USEGC
+  u.collections=GC_gc_no;
+  size_t heap=GC_get_heap_size();
+  if(heap > peakheap) peakheap=heap;
+  allocated=GC_get_total_bytes();
+#else
+  u.collections=0;
+#endif
+  return u;
+}
+
+// Charges what was used since the last change of phase to the current one.
+void charge()
+{
+  usage u=now();
+  account& a=accounts[current];
+  a.wall += u.wall-last.wall;
+  a.cpu += u.cpu-last.cpu;
+  a.childcpu += u.childcpu-last.childcpu;
+  a.collections += u.collections-last.collections;
+  last=u;
+}
+
+void sum(account& total)
+{
+  total=account();
+  for(size_t i=0; i < NPHASES; ++i) {
+    const account& a=accounts[i];
+    total.calls += a.calls;
+    total.wall += a.wall;
+    total.cpu += a.cpu;
+    total.childcpu += a.childcpu;
+    total.processes += a.processes;
+    total.written += a.written;
+    total.collections += a.collections;
+  }
+}
+
+size_t maxrss()
+{
+  struct rusage r;
+  return getrusage(RUSAGE_SELF,&r) == 0 ? 1024*(size_t) r.ru_maxrss : 0;
+}
+
+void row(ostream& out, const char *name, const account& a)
+{
+  out << std::left << std::setw(10) << name << std::right
+      << std::setw(7) << a.calls
+      << std::setw(10) << a.wall
+      << std::setw(10) << a.cpu
+      << std::setw(11) << a.childcpu
+      << std::setw(11) << a.processes
+      << std::setw(12) << a.written
+      << std::setw(13) << a.collections << "\n";
+}
+
+void text(ostream& out, const account& total)
+{
+  out << std::fixed << std::setprecision(3)
+      << "phase       calls   wall(s)    cpu(s)  child(s)  processes"
+      << "  written(B)  collections\n";
+  for(size_t i=0; i < NPHASES; ++i)
+    if(accounts[i].calls > 0)
+      row(out,names[i],accounts[i]);
+  row(out,"total",total);
+#ifdef USEGC
+  out << "allocated " << std::setprecision(1) << allocated/1048576.0
+      << "MB, peak heap " << peakheap/1048576.0 << "MB, ";
+#endif
+  out << "max RSS " << std::setprecision(1) << maxrss()/1048576.0 << "MB\n";
+}
+
+void fields(ostream& out, const account& a)
+{
+  out << "{\"calls\": " << a.calls
+      << ", \"wall\": " << a.wall
+      << ", \"cpu\": " << a.cpu
+      << ", \"childcpu\": " << a.childcpu
+      << ", \"processes\": " << a.processes
+      << ", \"written\": " << a.written
+      << ", \"collections\": " << a.collections << "}";
+}
+
+void json(ostream& out, const account& total)
+{
+  out << std::fixed << std::setprecision(6) << "{\n  \"phases\": {";
+  bool first=true;
+  for(size_t i=0; i < NPHASES; ++i) {
+    if(accounts[i].calls == 0) continue;
+    out << (first ? "\n" : ",\n") << "    \"" << names[i] << "\": ";
+    fields(out,accounts[i]);
+    first=false;
+  }
+  out << "\n  },\n  \"total\": ";
+  fields(out,total);
+  out << ",\n  \"allocated\": " << allocated
+      << ",\n  \"peakheap\": " << peakheap
+      << ",\n  \"maxrss\": " << maxrss() << "\n}\n";
+}
+
+} // private
+
+bool enter(phaseId id)
+{
+  if(id == current) return false;
+  charge();
+  outer.push_back(current);
+  current=id;
+  ++accounts[id].calls;
+  return true;
+}
+
+void leave()
+{
+  charge();
+  current=outer.back();
+  outer.pop_back();
+}
+
+void spawned()
+{
+  if(active)
+    ++accounts[current].processes;
+}
+
+void wrote(const string& filename)
+{
+  struct stat buf;
+  if(active && stat(filename.c_str(),&buf) == 0)
+    accounts[current].written += buf.st_size;
+}
+
+void start()
+{
+  if(!settings::getSetting<bool>("timings") &&
+     settings::getSetting<string>("timingsjson").empty())
+    return;
+  active=true;
+  last=now();
+  accounts[OTHER].calls=1;
+}
+
+void report()
+{
+  if(!active) return;
+  charge();
+  account total;
+  sum(total);
+
+  string filename=settings::getSetting<string>("timingsjson");
+  if(!filename.empty()) {
+    std::ofstream out(filename.c_str());
+    json(out,total);
+    if(!out)
+      cerr << "cannot write timings " << filename << endl;
+  }
+  if(settings::getSetting<bool>("timings")) {
+    ostringstream buf;
+    text(buf,total);
+    cerr << buf.str() << std::flush;
+  }
+}
+
+} // namespace timings
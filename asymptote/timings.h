@@ -0,0 +1,54 @@
+/*****
+ * timings.h
+ *
+ * Accounts for the time and resources used by each phase of a run, such as
+ * parsing, running the virtual machine, measuring labels, and each program
+ * run to ship out a picture, as requested by -timings.
+ *****/
+
+#ifndef TIMINGS_H
+#define TIMINGS_H
+
+#include "common.h"
+
+namespace timings {
+
+enum phaseId {OTHER, PARSE, TRANSLATE, RUN, LABELS, SHIPOUT, LATEX, DVIPS,
+              DVISVGM, GS, CONVERT, VIEW, NPHASES};
+
+extern bool active;
+
+// Enters a phase, returning false, and doing nothing, if it is the current
+// phase already.
+bool enter(phaseId id);
+void leave();
+
+// Charges what is used for the length of a scope to a phase, if when is
+// true.  Phases nest: while an inner phase runs, the outer one is not
+// charged, so that the phases add up to the whole run.  A phase entered
+// again within itself counts as a single call.
+class phase {
+  bool on;
+public:
+  phase(phaseId id, bool when=true) : on(active && when && enter(id)) {}
+  ~phase() {
+    if(on) leave();
+  }
+};
+
+// Counts a child process started in the current phase.
+void spawned();
+
+// Charges the size of a file just written to the current phase.
+void wrote(const string& filename);
+
+// Starts accounting, if asked for by -timings or -timingsjson.
+void start();
+
+// Prints the report to cerr, or writes it as JSON to the file named by
+// -timingsjson.
+void report();
+
+} // namespace timings
+
+#endif
@@ -47,7 +47,7 @@ void ratioTriples(pair &b, double (*m)(double, double), bool &first, size_t n, c
 void normalizeTriple(Triple v);
 void crossTriple(Triple n, const Triple u, const Triple v);
 
-class triple : virtual public gc {
+class triple : public gc {
   double x;
   double y;
   double z;
@@ -57,8 +57,6 @@ public:
   triple(double x, double y=0.0, double z=0.0) : x(x), y(y), z(z) {}
   triple(const Triple& v) : x(v[0]), y(v[1]), z(v[2]) {}
 
-  virtual ~triple() {}
-  
   void set(double X, double Y=0.0, double Z=0.0) { x=X; y=Y; z=Z; }
 
   double getx() const { return x; }
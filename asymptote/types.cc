@@ -47,6 +47,20 @@ namespace types {
                              
 nullTy pNull;
 ty *primNull() { return &pNull; }
+
+bool pointerFree(const ty *t)
+{
+  switch (t->kind) {
+    case ty_Int:
+      return vm::pointerFree<Int>::value;
+    case ty_real:
+      return vm::pointerFree<double>::value;
+    case ty_boolean:
+      return vm::pointerFree<bool>::value;
+    default:
+      return false;
+  }
+}
   
 const char *names[] = {
   "null",
@@ -236,7 +250,10 @@ trans::access *nullTy::castTo(ty *target, caster &) {
 
 trans::access *array::initializer()
 {
-  RETURN_STATIC_BLTIN(emptyArray)
+  if (pointerFree(celltype))
+    RETURN_STATIC_BLTIN(emptyAtomicArray)
+  else
+    RETURN_STATIC_BLTIN(emptyArray)
 }
 
 ty *array::pushType()
@@ -477,6 +494,8 @@ ty *function::stripDefaults()
 }
 #endif
 
+size_t overloaded::lastId=0;
+
 // Only add a type with a signature distinct from the ones currently
 // in the overloaded type.
 void overloaded::addDistinct(ty *t, bool special)
@@ -292,6 +292,10 @@ struct array : public ty {
 
 ty *primNull();
 
+// Whether the values of type t hold no pointers into the heap, in which case
+// arrays of them are created atomic.
+bool pointerFree(const ty *t);
+
 
 struct formal {
   ty *t;
@@ -504,18 +508,28 @@ struct function : public ty {
 
 // This is used in getType expressions when an overloaded variable is accessed.
 class overloaded : public ty {
+  static size_t lastId;
 public:
   ty_vector sub;
 
+  // Identifies the set of types in sub: it is renewed whenever the set
+  // changes, so that the resolution of a call to the set can be cached.
+  // Code that changes sub directly must call changed().
+  size_t id;
+
   // Warning: The venv endScope routine relies heavily on the current
   // implementation of overloaded.
 public:
   overloaded()
-    : ty(ty_overloaded) {}
+    : ty(ty_overloaded), id(++lastId) {}
   overloaded(ty *t)
-    : ty(ty_overloaded) { add(t); }
+    : ty(ty_overloaded), id(++lastId) { add(t); }
   virtual ~overloaded() {}
 
+  void changed() {
+    id=++lastId;
+  }
+
   bool equiv(const ty *other) const
   {
     for(ty_vector::const_iterator i=sub.begin();i!=sub.end();++i)
@@ -538,6 +552,7 @@ public:
     }
     else
       sub.push_back(t);
+    changed();
   }
 
   // Only add a type distinct from the ones currently in the overloaded type.
@@ -25,6 +25,7 @@
 #include "errormsg.h"
 #include "camperror.h"
 #include "interact.h"
+#include "timings.h"
 
 using namespace settings;
 
@@ -284,6 +285,7 @@ int System(const mem::vector<string> &command, int quiet, bool wait,
     }
   }
 
+  timings::spawned();
   if(ppid) *ppid=pid;
   for(;;) {
     if(waitpid(pid, &status, wait ? 0 : WNOHANG) == -1) {
@@ -48,9 +48,11 @@ void arrayinit::prettyprint(ostream &out, Int indent)
     rest->prettyprint(out, indent+1);
 }
 
-void arrayinit::transMaker(coenv &e, Int size, bool rest) {
+void arrayinit::transMaker(coenv &e, Int size, bool rest,
+                           types::ty *celltype) {
   // Push the number of cells and call the array maker.
   e.c.encode(inst::intpush, size);
+  e.c.encode(inst::constpush, (item)(celltype && pointerFree(celltype)));
   e.c.encode(inst::builtin, rest ? run::newAppendedArray :
              run::newInitializedArray);
 }
@@ -74,7 +76,7 @@ void arrayinit::transToType(coenv &e, types::ty *target)
   if (rest)
     rest->transToType(e, target);
   
-  transMaker(e, (Int)inits.size(), (bool)rest);
+  transMaker(e, (Int)inits.size(), (bool)rest, celltype);
 }
 
 } // namespace absyntax
@@ -66,8 +66,10 @@ public:
 
   void prettyprint(ostream &out, Int indent);
 
-  // Encodes the instructions to make an array from size elements on the stack.
-  static void transMaker(coenv &e, Int size, bool rest);
+  // Encodes the instructions to make an array from size elements of type
+  // celltype on the stack.
+  static void transMaker(coenv &e, Int size, bool rest,
+                         types::ty *celltype);
 
   void transToType(coenv &e, types::ty *target);
 
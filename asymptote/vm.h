@@ -12,14 +12,45 @@
 
 namespace vm {
 
-struct lambda; class stack;
+struct lambda; class stack; class item;
 typedef void (*bltin)(stack *s);
 
+// The names of the bltin functions generated by runtime.pl, which are
+// registered in tables ending with a null entry.  They are printed in
+// profiles.
+struct bltinName {
+  bltin f;
+  const char *name;
+};
+
+void registerBltinNames(const bltinName *table);
+
+// Returns the name of a bltin function, or an empty string if unknown.
+string lookupBltin(bltin b);
+
+// A builtin generated by runtime.pl whose arguments and result are all
+// unboxed values also has a native entry point, which reads its arguments
+// from consecutive items and stores its result over the first, so that the
+// virtual machine need not pop the arguments and push the result.  These are
+// registered in tables ending with a null entry.
+typedef void (*nativeBltin)(item *args);
+
+struct nativeEntry {
+  bltin f;
+  nativeBltin direct;
+  size_t arity;
+};
+
+void registerNatives(const nativeEntry *table);
+
+// Returns the native entry point of a bltin function, or null if it has none.
+const nativeEntry *lookupNative(bltin f);
+
 #ifdef DEBUG_BLTIN
-// This associates names to bltin functions, so that the output of 'asy -s'
-// can print the names of the bltin functions that appear in the bytecode.
+// This associates names to the other bltin functions, so that the output of
+// 'asy -s' can print the names of the bltin functions that appear in the
+// bytecode.
 void registerBltin(bltin b, string s);
-string lookupBltin(bltin b);
 
 #define REGISTER_BLTIN(b, s) \
     registerBltin((b), (s))